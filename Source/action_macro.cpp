@@ -0,0 +1,188 @@
+#include "action_macro.h"
+#include "reaper_plugin_functions.h"
+
+ActionMacroEngine::ActionMacroEngine(std::function<bool(int)> runextensionaction) :
+	m_run_extension_action(runextensionaction)
+{
+}
+
+int ActionMacroEngine::resolveStep(const String& step) const
+{
+	if (step.containsOnly("0123456789"))
+		return step.getIntValue();
+	int command = NamedCommandLookup(step.toRawUTF8());
+	// extension actions are looked up with a leading underscore
+	if (command == 0 && step.startsWithChar('_') == false)
+		command = NamedCommandLookup(("_" + step).toRawUTF8());
+	return command;
+}
+
+void ActionMacroEngine::appendSteps(const StringArray& steps, std::vector<int>& dest, StringArray& unresolved, StringArray& chain) const
+{
+	for (auto& step : steps)
+	{
+		int command = resolveStep(step);
+		if (command <= 0)
+		{
+			unresolved.addIfNotAlreadyThere(step);
+			continue;
+		}
+		const ActionMacro* inner = nullptr;
+		for (auto& m : m_macros)
+			if (m->m_command_id != 0 && m->m_command_id == command)
+				inner = m.get();
+		if (inner == nullptr)
+		{
+			dest.push_back(command);
+			continue;
+		}
+		// a macro that ends up including itself is reported and left out
+		if (chain.contains(inner->m_name) == true)
+		{
+			unresolved.addIfNotAlreadyThere(step + " (includes itself)");
+			continue;
+		}
+		// inlined from the steps, not from the compiled commands, which may be stale or not exist yet
+		chain.add(inner->m_name);
+		appendSteps(inner->m_steps, dest, unresolved, chain);
+		chain.removeString(inner->m_name);
+	}
+}
+
+ActionMacro ActionMacroEngine::compile(String name, StringArray steps) const
+{
+	ActionMacro macro;
+	macro.m_name = name;
+	for (auto& s : steps)
+	{
+		String step = s.trim();
+		if (step.isEmpty())
+			continue;
+		// would break the stored form
+		if (isValidName(step) == false)
+		{
+			macro.m_unresolved.add(step);
+			continue;
+		}
+		macro.m_steps.add(step);
+	}
+	StringArray chain(name);
+	appendSteps(macro.m_steps, macro.m_commands, macro.m_unresolved, chain);
+	macro.m_compiled = true;
+	return macro;
+}
+
+ActionMacro& ActionMacroEngine::addMacro(ActionMacro macro)
+{
+	ActionMacro* result = nullptr;
+	for (auto& m : m_macros)
+	{
+		if (m->m_name == macro.m_name)
+		{
+			// keeps the command id of the existing action
+			macro.m_command_id = m->m_command_id;
+			*m = macro;
+			result = m.get();
+			break;
+		}
+	}
+	if (result == nullptr)
+	{
+		m_macros.push_back(std::make_unique<ActionMacro>(macro));
+		return *m_macros.back();
+	}
+	// macros are few and short, compiling all of them again is cheaper than tracking who inlines whom
+	for (auto& m : m_macros)
+	{
+		if (m.get() == result || m->m_compiled == false)
+			continue;
+		m->m_commands.clear();
+		m->m_unresolved.clear();
+		StringArray chain(m->m_name);
+		appendSteps(m->m_steps, m->m_commands, m->m_unresolved, chain);
+	}
+	return *result;
+}
+
+ActionMacro& ActionMacroEngine::declareMacro(String name, StringArray steps)
+{
+	ActionMacro macro;
+	macro.m_name = name;
+	for (auto& s : steps)
+		if (s.trim().isNotEmpty())
+			macro.m_steps.add(s.trim());
+	return addMacro(macro);
+}
+
+void ActionMacroEngine::compilePending()
+{
+	for (auto& m : m_macros)
+	{
+		if (m->m_compiled == true)
+			continue;
+		m->m_commands.clear();
+		m->m_unresolved.clear();
+		StringArray chain(m->m_name);
+		appendSteps(m->m_steps, m->m_commands, m->m_unresolved, chain);
+		m->m_compiled = true;
+	}
+}
+
+bool ActionMacroEngine::isValidName(const String& name)
+{
+	return name.trim().isNotEmpty() && name.containsAnyOf("|;,") == false;
+}
+
+ActionMacro* ActionMacroEngine::findMacroByCommand(int command)
+{
+	for (auto& m : m_macros)
+		if (m->m_command_id == command)
+			return m.get();
+	return nullptr;
+}
+
+void ActionMacroEngine::run(ActionMacro& macro)
+{
+	if (macro.m_compiled == false)
+		compilePending();
+	// a step may redefine the macro that is running
+	const std::vector<int> commands = macro.m_commands;
+	if (m_run_depth > 0)
+	{
+		// already inside a macro, the outer one holds the undo block and the refresh
+		for (int command : commands)
+			if (m_run_extension_action(command) == false)
+				Main_OnCommand(command, 0);
+		return;
+	}
+	++m_run_depth;
+	PreventUIRefresh(1);
+	Undo_BeginBlock();
+	for (int command : commands)
+		if (m_run_extension_action(command) == false)
+			Main_OnCommand(command, 0);
+	Undo_EndBlock(("Macro : " + macro.m_name).toRawUTF8(), -1);
+	PreventUIRefresh(-1);
+	--m_run_depth;
+}
+
+String ActionMacroEngine::serialize() const
+{
+	StringArray entries;
+	for (auto& m : m_macros)
+		entries.add(m->m_name + "|" + m->m_steps.joinIntoString(","));
+	return entries.joinIntoString(";");
+}
+
+std::vector<std::pair<String, StringArray>> ActionMacroEngine::deserialize(const String& txt)
+{
+	std::vector<std::pair<String, StringArray>> result;
+	for (auto& entry : StringArray::fromTokens(txt, ";", ""))
+	{
+		String name = entry.upToFirstOccurrenceOf("|", false, false).trim();
+		if (name.isEmpty())
+			continue;
+		result.emplace_back(name, StringArray::fromTokens(entry.fromFirstOccurrenceOf("|", false, false), ",", ""));
+	}
+	return result;
+}
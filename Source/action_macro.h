@@ -0,0 +1,50 @@
+#pragma once
+
+#include "JuceHeader.h"
+
+// A named list of actions. The steps are resolved to command ids once when the macro is compiled,
+// and steps that are themselves macros are inlined, so running it is a walk over a flat array.
+struct ActionMacro
+{
+	String m_name;
+	StringArray m_steps; // as entered
+	std::vector<int> m_commands;
+	StringArray m_unresolved;
+	int m_command_id = 0; // of the action that runs the macro, 0 until registered
+	bool m_compiled = false;
+};
+
+// Runs macros inside one undo block with the UI refresh held off for the whole sequence, so a long
+// macro produces a single undo point and a single redraw.
+class ActionMacroEngine
+{
+public:
+	// Runs an action of this extension, returns false for command ids that are not ours. Those are
+	// run with Main_OnCommand.
+	ActionMacroEngine(std::function<bool(int)> runextensionaction);
+	// Steps are REAPER command ids, named command ids like _SWS_ABOUT, or our JUCETEST_ ids
+	ActionMacro compile(String name, StringArray steps) const;
+	// Replaces a macro with the same name. The compiled macros are compiled again, so the ones
+	// that inline the replaced macro run its new steps.
+	ActionMacro& addMacro(ActionMacro macro);
+	// Adds a macro without resolving its steps. Named commands of other extensions only exist
+	// once REAPER has loaded all of them, so stored macros are compiled later with compilePending,
+	// or on their first run.
+	ActionMacro& declareMacro(String name, StringArray steps);
+	void compilePending();
+	// names and steps are stored with | ; and , as separators, so they can not contain these
+	static bool isValidName(const String& name);
+	ActionMacro* findMacroByCommand(int command);
+	int getNumMacros() const { return (int)m_macros.size(); }
+	ActionMacro& getMacro(int index) { return *m_macros[index]; }
+	void run(ActionMacro& macro);
+	// "name|step,step;name|step..." for the REAPER ext state
+	String serialize() const;
+	static std::vector<std::pair<String, StringArray>> deserialize(const String& txt);
+private:
+	int resolveStep(const String& step) const;
+	void appendSteps(const StringArray& steps, std::vector<int>& dest, StringArray& unresolved, StringArray& chain) const;
+	std::function<bool(int)> m_run_extension_action;
+	std::vector<std::unique_ptr<ActionMacro>> m_macros;
+	int m_run_depth = 0;
+};
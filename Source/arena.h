@@ -0,0 +1,72 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <type_traits>
+#include <utility>
+
+// Bump allocator for many small objects that share a lifetime. reset() destroys the objects in
+// reverse order of creation and releases their memory all at once, the blocks are kept for the
+// next round, so a steady state allocates nothing.
+class Arena
+{
+public:
+	explicit Arena(size_t blocksize = 65536) : m_block_size(blocksize) {}
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+	~Arena() { reset(); }
+	template<typename T, typename... Args>
+	T* create(Args&&... args)
+	{
+		T* obj = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+		if (std::is_trivially_destructible<T>::value == false)
+			m_destructors.push_back({ obj, [](void* p) { static_cast<T*>(p)->~T(); } });
+		return obj;
+	}
+	void* allocate(size_t size, size_t align)
+	{
+		for (;;)
+		{
+			if (m_current < m_blocks.size())
+			{
+				Block& b = m_blocks[m_current];
+				size_t offset = (m_offset + align - 1) & ~(align - 1);
+				if (offset + size <= b.m_size)
+				{
+					m_offset = offset + size;
+					return b.m_data.get() + offset;
+				}
+				++m_current;
+				m_offset = 0;
+				continue;
+			}
+			size_t blocksize = size + align > m_block_size ? size + align : m_block_size;
+			m_blocks.push_back({ std::unique_ptr<char[]>(new char[blocksize]), blocksize });
+		}
+	}
+	void reset()
+	{
+		for (auto it = m_destructors.rbegin(); it != m_destructors.rend(); ++it)
+			it->m_func(it->m_obj);
+		m_destructors.clear();
+		m_current = 0;
+		m_offset = 0;
+	}
+	size_t getNumBlocks() const { return m_blocks.size(); }
+private:
+	struct Block
+	{
+		std::unique_ptr<char[]> m_data;
+		size_t m_size = 0;
+	};
+	struct Destructor
+	{
+		void* m_obj;
+		void(*m_func)(void*);
+	};
+	size_t m_block_size = 65536;
+	std::vector<Block> m_blocks;
+	size_t m_current = 0;
+	size_t m_offset = 0;
+	std::vector<Destructor> m_destructors;
+};
@@ -0,0 +1,210 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "audio2midi_analysis.h"
+#include "source_reader.h"
+#include "midi_bulk_writer.h"
+#include "task_pool.h"
+#include "main_thread_tasks.h"
+
+// Converts the audio of the first selected item into notes on a new track below it. The
+// source is analysed as an interactive task on the shared task pool, the MIDI item is created
+// from a task posted to the main thread.
+class Audio2MIDIGUI : public Component, public Button::Listener, private Timer
+{
+public:
+	Audio2MIDIGUI()
+	{
+		addAndMakeVisible(&m_convert_button);
+		m_convert_button.setButtonText("Convert selected item");
+		m_convert_button.setTooltip("Track the pitch of the first selected item and write the notes on a new track");
+		m_convert_button.addListener(this);
+		addAndMakeVisible(&m_cancel_button);
+		m_cancel_button.setButtonText("Cancel");
+		m_cancel_button.setEnabled(false);
+		m_cancel_button.addListener(this);
+		addAndMakeVisible(&m_threshold_slider);
+		m_threshold_slider.setRange(0.02, 0.5);
+		m_threshold_slider.setValue(0.15);
+		m_threshold_slider.setTooltip("Aperiodicity threshold, lower only accepts clearer pitches");
+		addAndMakeVisible(&m_silence_slider);
+		m_silence_slider.setRange(-90.0, -10.0, 1.0);
+		m_silence_slider.setValue(-50.0);
+		m_silence_slider.setTooltip("Silence level (dB)");
+		addAndMakeVisible(&m_min_note_slider);
+		m_min_note_slider.setRange(10.0, 500.0, 1.0);
+		m_min_note_slider.setValue(60.0);
+		m_min_note_slider.setTooltip("Shortest note (ms)");
+		addAndMakeVisible(&m_freq_range_slider);
+		m_freq_range_slider.setSliderStyle(Slider::TwoValueHorizontal);
+		m_freq_range_slider.setRange(30.0, 4000.0, 1.0);
+		m_freq_range_slider.setSkewFactorFromMidPoint(400.0);
+		m_freq_range_slider.setMinAndMaxValues(50.0, 2000.0);
+		m_freq_range_slider.setTooltip("Frequency range (Hz)");
+		addAndMakeVisible(&m_status_label);
+		setSize(400, 200);
+	}
+	~Audio2MIDIGUI()
+	{
+		// the analysis reads m_tasks, so it must be finished before the group goes away.
+		// Its finish task is then skipped through m_main_thread.
+		if (m_tasks != nullptr)
+		{
+			m_tasks->cancel();
+			m_tasks->wait();
+		}
+	}
+	void resized() override
+	{
+		m_convert_button.setBounds(1, 1, 150, 24);
+		m_cancel_button.setBounds(m_convert_button.getRight() + 2, 1, 70, 24);
+		m_threshold_slider.setBounds(1, 30, getWidth() - 2, 24);
+		m_silence_slider.setBounds(1, 55, getWidth() - 2, 24);
+		m_min_note_slider.setBounds(1, 80, getWidth() - 2, 24);
+		m_freq_range_slider.setBounds(1, 105, getWidth() - 2, 24);
+		m_status_label.setBounds(1, 130, getWidth() - 2, 24);
+	}
+	void buttonClicked(Button* but) override
+	{
+		if (but == &m_convert_button)
+			startConversion();
+		if (but == &m_cancel_button && m_tasks != nullptr)
+			m_tasks->cancel();
+	}
+private:
+	void startConversion()
+	{
+		if (m_running == true)
+			return;
+		MediaItem* item = GetSelectedMediaItem(nullptr, 0);
+		MediaItem_Take* take = item != nullptr ? GetActiveTake(item) : nullptr;
+		if (take == nullptr)
+			return;
+		m_filename = getTakeSourceFileName(take);
+		if (m_filename.isEmpty())
+		{
+			m_status_label.setText("The selected item has no audio file", dontSendNotification);
+			return;
+		}
+		m_item = item;
+		m_take_name = String(CharPointer_UTF8(GetTakeName(take)));
+		m_item_pos = *(double*)GetSetMediaItemInfo(item, "D_POSITION", nullptr);
+		m_item_len = *(double*)GetSetMediaItemInfo(item, "D_LENGTH", nullptr);
+		m_playrate = *(double*)GetSetMediaItemTakeInfo(take, "D_PLAYRATE", nullptr);
+		m_source_start = *(double*)GetSetMediaItemTakeInfo(take, "D_STARTOFFS", nullptr);
+		m_params.m_threshold = m_threshold_slider.getValue();
+		m_params.m_silence_db = m_silence_slider.getValue();
+		m_params.m_min_note_seconds = m_min_note_slider.getValue() / 1000.0;
+		m_params.m_min_freq = m_freq_range_slider.getMinValue();
+		m_params.m_max_freq = m_freq_range_slider.getMaxValue();
+		m_progress = 0.0;
+		m_convert_button.setEnabled(false);
+		m_cancel_button.setEnabled(true);
+		m_start_time = Time::getMillisecondCounterHiRes();
+		m_running = true;
+		// a cancelled group stays cancelled, so each conversion gets its own
+		m_tasks = std::make_unique<TaskGroup>(*g_task_pool, "Audio2MIDI analysis", TaskPriority::Interactive);
+		m_tasks->add([this]() { analyse(); });
+		startTimer(100);
+	}
+	void analyse()
+	{
+		m_notes.clear();
+		SourceReader reader(m_filename);
+		m_ok = analyseAudio2MIDI(reader, m_source_start, m_item_len * m_playrate, m_params, m_notes, [this](double progress)
+		{
+			m_progress = progress;
+			return m_tasks->isCancelled() == false;
+		});
+		postFinish();
+	}
+	void postFinish()
+	{
+		// the timer tries again if the queue was full
+		m_finish_pending = m_main_thread.post([this]() { finish(); }) == false;
+	}
+	void timerCallback() override
+	{
+		if (m_finish_pending.exchange(false) == true)
+			postFinish();
+		m_status_label.setText("Analysing " + String(m_progress.load() * 100.0, 0) + "%", dontSendNotification);
+	}
+	void finish()
+	{
+		stopTimer();
+		m_running = false;
+		m_convert_button.setEnabled(true);
+		m_cancel_button.setEnabled(false);
+		if (m_ok == false)
+		{
+			m_status_label.setText("Cancelled or could not read the source", dontSendNotification);
+			return;
+		}
+		if (ValidatePtr(m_item, "MediaItem*") == false)
+		{
+			m_status_label.setText("The item was removed during the analysis", dontSendNotification);
+			return;
+		}
+		writeNotes();
+		double secs = (Time::getMillisecondCounterHiRes() - m_start_time) / 1000.0;
+		m_status_label.setText(String((int)m_notes.size()) + " notes in " + String(secs, 1) + " s, "
+			+ String(m_item_len / jmax(0.001, secs), 1) + "x realtime", dontSendNotification);
+		// the notes are in the project now
+		m_notes = std::vector<Audio2MIDINote>();
+	}
+	void writeNotes()
+	{
+		MediaTrack* srctrack = GetMediaItem_Track(m_item);
+		Undo_BeginBlock();
+		PreventUIRefresh(1);
+		// CSurf_TrackToID is 1 based, so it is also the index right below the track
+		int newindex = CSurf_TrackToID(srctrack, false);
+		InsertTrackAtIndex(newindex, false);
+		MediaTrack* track = GetTrack(nullptr, newindex);
+		GetSetMediaTrackInfo_String(track, "P_NAME", (char*)(m_take_name + " (Audio2MIDI)").toRawUTF8(), true);
+		MediaItem* item = CreateNewMIDIItemInProj(track, m_item_pos, m_item_pos + m_item_len, nullptr);
+		MediaItem_Take* take = GetActiveTake(item);
+		if (take != nullptr)
+		{
+			MIDIBulkWriter writer;
+			for (auto& note : m_notes)
+			{
+				// source time to project time through the take's offset and playrate
+				double start = m_item_pos + (note.m_start - m_source_start) / m_playrate;
+				double end = m_item_pos + (note.m_end - m_source_start) / m_playrate;
+				writer.addNote(MIDI_GetPPQPosFromProjTime(take, start), MIDI_GetPPQPosFromProjTime(take, end), 0, note.m_pitch, note.m_velocity);
+			}
+			writer.replaceTakeEvents(take);
+			GetSetMediaItemTakeInfo_String(take, "P_NAME", (char*)m_take_name.toRawUTF8(), true);
+		}
+		PreventUIRefresh(-1);
+		TrackList_AdjustWindows(false);
+		UpdateArrange();
+		Undo_EndBlock("Audio2MIDI : convert item", -1);
+	}
+	TextButton m_convert_button;
+	TextButton m_cancel_button;
+	Slider m_threshold_slider;
+	Slider m_silence_slider;
+	Slider m_min_note_slider;
+	Slider m_freq_range_slider;
+	Label m_status_label;
+	// written on the message thread before the worker starts, read by the worker
+	MediaItem* m_item = nullptr;
+	String m_filename;
+	String m_take_name;
+	double m_item_pos = 0.0;
+	double m_item_len = 0.0;
+	double m_playrate = 1.0;
+	double m_source_start = 0.0;
+	Audio2MIDIParams m_params;
+	// written by the worker, read after the async update
+	std::vector<Audio2MIDINote> m_notes;
+	bool m_ok = false;
+	std::atomic<double> m_progress{ 0.0 };
+	double m_start_time = 0.0;
+	bool m_running = false;
+	std::atomic<bool> m_finish_pending{ false };
+	MainThreadTaskToken m_main_thread;
+	std::unique_ptr<TaskGroup> m_tasks;
+};
@@ -0,0 +1,200 @@
+#include "audio2midi_analysis.h"
+#include "source_reader.h"
+
+YinPitchTracker::YinPitchTracker(double samplerate, const Audio2MIDIParams& params) : m_samplerate(samplerate), m_params(params)
+{
+	// the lag range must cover the lowest frequency
+	int maxtau = (int)std::ceil(samplerate / params.m_min_freq) + 2;
+	int order = 1;
+	while ((1 << order) < 2 * maxtau)
+		++order;
+	m_frame_size = 1 << order;
+	m_window = m_frame_size / 2;
+	m_hop_size = jmax(1, roundToInt(samplerate * 0.01));
+	m_min_tau = jmax(2, (int)(samplerate / params.m_max_freq));
+	m_fft = std::make_unique<dsp::FFT>(order);
+	m_spec_a.resize(2 * m_frame_size);
+	m_spec_b.resize(2 * m_frame_size);
+	m_energies.resize(m_frame_size + 1);
+	m_diff.resize(m_window);
+}
+
+Audio2MIDIPitchFrame YinPitchTracker::analyse(const float* frame)
+{
+	Audio2MIDIPitchFrame result;
+	const int n = m_frame_size;
+	const int w = m_window;
+	// running sums of squares, energy of x[tau..tau+w) is m_energies[tau+w] - m_energies[tau]
+	m_energies[0] = 0.0;
+	for (int i = 0; i < n; ++i)
+		m_energies[i + 1] = m_energies[i] + (double)frame[i] * frame[i];
+	double e0 = m_energies[w];
+	result.m_rms = std::sqrt(e0 / w);
+	if (e0 <= 0.0)
+		return result;
+	// c(tau) = sum x[j] x[j+tau] for j < w. j + tau stays below n, so the circular
+	// correlation of the FFT equals the linear one
+	std::fill(m_spec_a.begin(), m_spec_a.end(), 0.0f);
+	std::fill(m_spec_b.begin(), m_spec_b.end(), 0.0f);
+	std::copy(frame, frame + w, m_spec_a.begin());
+	std::copy(frame, frame + n, m_spec_b.begin());
+	m_fft->performRealOnlyForwardTransform(m_spec_a.data());
+	m_fft->performRealOnlyForwardTransform(m_spec_b.data());
+	for (int i = 0; i < n; ++i)
+	{
+		// conj(A) * B
+		float ar = m_spec_a[2 * i], ai = m_spec_a[2 * i + 1];
+		float br = m_spec_b[2 * i], bi = m_spec_b[2 * i + 1];
+		m_spec_a[2 * i] = ar * br + ai * bi;
+		m_spec_a[2 * i + 1] = ar * bi - ai * br;
+	}
+	m_fft->performRealOnlyInverseTransform(m_spec_a.data());
+	// whatever scaling the inverse transform uses, c(0) must equal e0
+	double scale = m_spec_a[0] != 0.0f ? e0 / m_spec_a[0] : 0.0;
+	// cumulative mean normalized difference
+	m_diff[0] = 1.0;
+	double runningsum = 0.0;
+	for (int tau = 1; tau < w; ++tau)
+	{
+		double d = e0 + (m_energies[tau + w] - m_energies[tau]) - 2.0 * scale * m_spec_a[tau];
+		runningsum += d;
+		m_diff[tau] = runningsum > 0.0 ? d * tau / runningsum : 1.0;
+	}
+	int besttau = -1;
+	for (int tau = m_min_tau; tau < w - 1; ++tau)
+	{
+		if (m_diff[tau] < m_params.m_threshold)
+		{
+			while (tau + 1 < w - 1 && m_diff[tau + 1] < m_diff[tau])
+				++tau;
+			besttau = tau;
+			break;
+		}
+	}
+	if (besttau < 0)
+	{
+		result.m_aperiodicity = *std::min_element(m_diff.begin() + m_min_tau, m_diff.end());
+		return result;
+	}
+	// parabolic interpolation around the minimum
+	double a = m_diff[besttau - 1], b = m_diff[besttau], c = m_diff[besttau + 1];
+	double denom = a - 2.0 * b + c;
+	double offset = denom != 0.0 ? jlimit(-0.5, 0.5, 0.5 * (a - c) / denom) : 0.0;
+	result.m_freq = m_samplerate / (besttau + offset);
+	result.m_aperiodicity = b;
+	return result;
+}
+
+void Audio2MIDISegmenter::endNote(double time)
+{
+	if (m_in_note == false)
+		return;
+	m_in_note = false;
+	if (time - m_note_start < m_params.m_min_note_seconds)
+		return;
+	int best = 0;
+	for (int i = 1; i < 128; ++i)
+		if (m_histogram[i] > m_histogram[best])
+			best = i;
+	Audio2MIDINote note;
+	note.m_start = m_note_start;
+	note.m_end = time;
+	note.m_pitch = best;
+	// -60 dB..0 dB of the loudest frame to velocity 1..127
+	double db = Decibels::gainToDecibels(m_note_max_rms, -60.0);
+	note.m_velocity = jlimit(1, 127, roundToInt(1.0 + (db + 60.0) / 60.0 * 126.0));
+	m_notes.push_back(note);
+}
+
+void Audio2MIDISegmenter::addFrame(double time, const Audio2MIDIPitchFrame& frame)
+{
+	bool voiced = frame.m_freq > 0.0 && Decibels::gainToDecibels(frame.m_rms, -200.0) > m_params.m_silence_db;
+	if (voiced == false)
+	{
+		endNote(time);
+		return;
+	}
+	int pitch = jlimit(0, 127, roundToInt(69.0 + 12.0 * std::log2(frame.m_freq / 440.0)));
+	if (m_in_note == true)
+	{
+		// two frames off the note pitch in a row start a new note, single frame glitches don't
+		if (pitch != m_note_pitch)
+		{
+			if (m_off_pitch_frames == 0)
+				m_off_pitch_start = time;
+			++m_off_pitch_frames;
+		}
+		else m_off_pitch_frames = 0;
+		if (m_off_pitch_frames < 2)
+		{
+			++m_histogram[pitch];
+			m_note_max_rms = jmax(m_note_max_rms, frame.m_rms);
+			return;
+		}
+		// the new note began where the pitch first moved away
+		time = m_off_pitch_start;
+		endNote(time);
+	}
+	m_in_note = true;
+	m_note_start = time;
+	m_note_max_rms = frame.m_rms;
+	std::fill(std::begin(m_histogram), std::end(m_histogram), 0);
+	++m_histogram[pitch];
+	m_note_pitch = pitch;
+	m_off_pitch_frames = 0;
+}
+
+void Audio2MIDISegmenter::finish(double time)
+{
+	endNote(time);
+}
+
+bool analyseAudio2MIDI(SourceReader& reader, double start, double length, const Audio2MIDIParams& params,
+	std::vector<Audio2MIDINote>& notes, std::function<bool(double)> progress)
+{
+	if (reader.isValid() == false)
+		return false;
+	const double sr = reader.getSampleRate();
+	const int nch = reader.getNumChannels();
+	YinPitchTracker tracker(sr, params);
+	Audio2MIDISegmenter segmenter(params);
+	const int framesize = tracker.getFrameSize();
+	const int hop = tracker.getHopSize();
+	reader.seek(start);
+	reader.setEnd(start + length);
+	std::vector<ReaSample> block;
+	// mono samples not yet consumed, never more than one block plus one analysis frame
+	std::vector<float> fifo;
+	int64 fifostart = 0; // sample position of fifo[0] relative to start
+	for (;;)
+	{
+		int got = reader.readNext(32768, block);
+		if (got <= 0)
+			break;
+		size_t oldsize = fifo.size();
+		fifo.resize(oldsize + got);
+		for (int i = 0; i < got; ++i)
+		{
+			double sum = 0.0;
+			for (int c = 0; c < nch; ++c)
+				sum += block[(size_t)i * nch + c];
+			fifo[oldsize + i] = (float)(sum / nch);
+		}
+		size_t pos = 0;
+		while (pos + framesize <= fifo.size())
+		{
+			auto frame = tracker.analyse(fifo.data() + pos);
+			// the frame's pitch is placed at the middle of its first half
+			double t = start + (fifostart + (int64)pos + framesize / 4) / sr;
+			segmenter.addFrame(t, frame);
+			pos += hop;
+		}
+		fifo.erase(fifo.begin(), fifo.begin() + pos);
+		fifostart += pos;
+		if (progress && progress(length > 0.0 ? (fifostart / sr) / length : 1.0) == false)
+			return false;
+	}
+	segmenter.finish(start + (fifostart + (int64)fifo.size()) / sr);
+	notes = std::move(segmenter.getNotes());
+	return true;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "JuceHeader.h"
+
+class SourceReader;
+
+struct Audio2MIDIParams
+{
+	double m_min_freq = 50.0;
+	double m_max_freq = 2000.0;
+	// YIN aperiodicity threshold, lower accepts only clearer pitches
+	double m_threshold = 0.15;
+	// frames quieter than this are unvoiced
+	double m_silence_db = -50.0;
+	double m_min_note_seconds = 0.06;
+};
+
+struct Audio2MIDINote
+{
+	double m_start = 0.0; // seconds in the source
+	double m_end = 0.0;
+	int m_pitch = 60;
+	int m_velocity = 100;
+};
+
+struct Audio2MIDIPitchFrame
+{
+	double m_freq = 0.0; // 0 when no pitch was found
+	double m_aperiodicity = 1.0;
+	double m_rms = 0.0;
+};
+
+// YIN pitch detector. The difference function comes from an FFT cross correlation of the
+// first half of the frame with the whole frame, instead of the direct O(n^2) sum.
+class YinPitchTracker
+{
+public:
+	YinPitchTracker(double samplerate, const Audio2MIDIParams& params);
+	int getFrameSize() const { return m_frame_size; }
+	int getHopSize() const { return m_hop_size; }
+	Audio2MIDIPitchFrame analyse(const float* frame);
+private:
+	double m_samplerate = 44100.0;
+	Audio2MIDIParams m_params;
+	int m_frame_size = 2048;
+	int m_window = 1024;
+	int m_hop_size = 441;
+	int m_min_tau = 2;
+	std::unique_ptr<dsp::FFT> m_fft;
+	std::vector<float> m_spec_a;
+	std::vector<float> m_spec_b;
+	std::vector<double> m_energies;
+	std::vector<double> m_diff;
+};
+
+// Turns the pitch frames into notes. A note ends at an unvoiced frame or when the pitch moves
+// away from the note's pitch for a few frames. The note pitch is the most common semitone of
+// its frames, so memory does not grow with the note length.
+class Audio2MIDISegmenter
+{
+public:
+	Audio2MIDISegmenter(const Audio2MIDIParams& params) : m_params(params) {}
+	void addFrame(double time, const Audio2MIDIPitchFrame& frame);
+	void finish(double time);
+	std::vector<Audio2MIDINote>& getNotes() { return m_notes; }
+private:
+	void endNote(double time);
+	Audio2MIDIParams m_params;
+	std::vector<Audio2MIDINote> m_notes;
+	bool m_in_note = false;
+	double m_note_start = 0.0;
+	double m_note_max_rms = 0.0;
+	int m_histogram[128] = { 0 };
+	int m_note_pitch = -1;
+	int m_off_pitch_frames = 0;
+	double m_off_pitch_start = 0.0;
+};
+
+// Streams the source from start for length seconds block by block, memory use does not depend
+// on the length. progress is called between blocks with 0..1 and returns false to cancel.
+bool analyseAudio2MIDI(SourceReader& reader, double start, double length, const Audio2MIDIParams& params,
+	std::vector<Audio2MIDINote>& notes, std::function<bool(double)> progress);
@@ -0,0 +1,332 @@
+#include "audio_meter.h"
+#include "reaper_plugin_functions.h"
+
+#if JUCE_INTEL
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// Sample peak and sum of squares of a chunk, the chunks are short enough for float sums
+	void measurePeakAndSumSquares(const float* x, int len, float& peak, double& sumsq)
+	{
+		float mx = 0.0f;
+		float sum = 0.0f;
+		int i = 0;
+#if JUCE_INTEL
+		const __m128 absmask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+		__m128 vmax = _mm_setzero_ps();
+		__m128 vsum = _mm_setzero_ps();
+		for (; i + 4 <= len; i += 4)
+		{
+			__m128 v = _mm_loadu_ps(x + i);
+			vmax = _mm_max_ps(vmax, _mm_and_ps(v, absmask));
+			vsum = _mm_add_ps(vsum, _mm_mul_ps(v, v));
+		}
+		float tmp[4];
+		_mm_storeu_ps(tmp, vmax);
+		mx = jmax(jmax(tmp[0], tmp[1]), jmax(tmp[2], tmp[3]));
+		_mm_storeu_ps(tmp, vsum);
+		sum = tmp[0] + tmp[1] + tmp[2] + tmp[3];
+#endif
+		for (; i < len; ++i)
+		{
+			mx = jmax(mx, std::abs(x[i]));
+			sum += x[i] * x[i];
+		}
+		peak = jmax(peak, mx);
+		sumsq += sum;
+	}
+}
+
+const float* TruePeakDetector::getCoefficients()
+{
+	// Hann windowed sinc, phase p (1-3) interpolates at p/4 between the history samples
+	// x[n-6] and x[n-5], coefficient j is for x[n-j]
+	struct Table
+	{
+		Table()
+		{
+			for (int p = 1; p < 4; ++p)
+			{
+				float* c = m_coeffs + (p - 1) * TapsPerPhase;
+				double sum = 0.0;
+				for (int j = 0; j < TapsPerPhase; ++j)
+				{
+					double d = j - 6 + p / 4.0;
+					double sinc = std::sin(MathConstants<double>::pi * d) / (MathConstants<double>::pi * d);
+					double window = 0.5 * (1.0 + std::cos(MathConstants<double>::pi * d / 6.0));
+					c[j] = (float)(sinc * window);
+					sum += c[j];
+				}
+				// unity gain at DC
+				for (int j = 0; j < TapsPerPhase; ++j)
+					c[j] = (float)(c[j] / sum);
+			}
+		}
+		float m_coeffs[3 * TapsPerPhase];
+	};
+	static const Table table;
+	return table.m_coeffs;
+}
+
+float TruePeakDetector::process(const float* src, int len)
+{
+	const float* c = getCoefficients();
+	const float* x = src + HistoryLen;
+	float mx = 0.0f;
+	int n = 0;
+#if JUCE_INTEL
+	// 4 consecutive output positions per phase at once
+	__m128 vc[3 * TapsPerPhase];
+	for (int i = 0; i < 3 * TapsPerPhase; ++i)
+		vc[i] = _mm_set1_ps(c[i]);
+	const __m128 absmask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	__m128 vmax = _mm_setzero_ps();
+	for (; n + 4 <= len; n += 4)
+	{
+		for (int p = 0; p < 3; ++p)
+		{
+			const __m128* pc = vc + p * TapsPerPhase;
+			__m128 acc = _mm_setzero_ps();
+			for (int j = 0; j < TapsPerPhase; ++j)
+				acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(x + n - j), pc[j]));
+			vmax = _mm_max_ps(vmax, _mm_and_ps(acc, absmask));
+		}
+	}
+	float tmp[4];
+	_mm_storeu_ps(tmp, vmax);
+	mx = jmax(jmax(tmp[0], tmp[1]), jmax(tmp[2], tmp[3]));
+#endif
+	for (; n < len; ++n)
+	{
+		for (int p = 0; p < 3; ++p)
+		{
+			float acc = 0.0f;
+			for (int j = 0; j < TapsPerPhase; ++j)
+				acc += x[n - j] * c[p * TapsPerPhase + j];
+			mx = jmax(mx, std::abs(acc));
+		}
+	}
+	return mx;
+}
+
+AudioMeterEngine::AudioMeterEngine() : m_queue(64)
+{
+	memset(&m_reg, 0, sizeof(m_reg));
+	m_reg.OnAudioBuffer = onAudioBuffer;
+	m_reg.userdata1 = this;
+	// build the coefficient table here and not on the audio thread
+	TruePeakDetector::process(m_scratch, 0);
+}
+
+AudioMeterEngine::~AudioMeterEngine()
+{
+	stop();
+}
+
+bool AudioMeterEngine::start()
+{
+	if (m_registered == true)
+		return true;
+	m_registered = Audio_RegHardwareHook(true, &m_reg) != 0;
+	return m_registered;
+}
+
+void AudioMeterEngine::stop()
+{
+	if (m_registered == false)
+		return;
+	// REAPER does not call the hook anymore once this returns
+	Audio_RegHardwareHook(false, &m_reg);
+	m_registered = false;
+}
+
+void AudioMeterEngine::measureChannel(ChannelState& state, const ReaSample* buf, int len, bool truepeak)
+{
+	const int histlen = TruePeakDetector::HistoryLen;
+	for (int pos = 0; pos < len; pos += ChunkLen)
+	{
+		int chunklen = jmin(ChunkLen, len - pos);
+		memcpy(m_scratch, state.m_history, sizeof(state.m_history));
+		float* dest = m_scratch + histlen;
+		for (int i = 0; i < chunklen; ++i)
+			dest[i] = (float)buf[pos + i];
+		float peak = (float)state.m_peak;
+		measurePeakAndSumSquares(dest, chunklen, peak, state.m_sumsq);
+		state.m_peak = peak;
+		if (truepeak == true)
+			state.m_true_peak = jmax(state.m_true_peak, TruePeakDetector::process(m_scratch, chunklen));
+		memcpy(state.m_history, m_scratch + chunklen, sizeof(state.m_history));
+	}
+}
+
+void AudioMeterEngine::onAudioBuffer(bool isPost, int len, double srate, audio_hook_register_t* reg)
+{
+	auto self = (AudioMeterEngine*)reg->userdata1;
+	int64 t0 = Time::getHighResolutionTicks();
+	bool truepeak = self->m_true_peak_enabled.load(std::memory_order_relaxed);
+	// inputs are as recorded before REAPER processes the buffer, outputs as played after
+	if (isPost == false)
+	{
+		self->m_hook_ticks = 0;
+		self->m_num_inputs = jmin(reg->input_nch, MaxMeterChannels);
+		for (int i = 0; i < self->m_num_inputs; ++i)
+		{
+			ReaSample* buf = reg->GetBuffer(false, i);
+			if (buf != nullptr)
+				self->measureChannel(self->m_inputs[i], buf, len, truepeak);
+		}
+		self->m_hook_ticks += Time::getHighResolutionTicks() - t0;
+		return;
+	}
+	self->m_num_outputs = jmin(reg->output_nch, MaxMeterChannels);
+	for (int i = 0; i < self->m_num_outputs; ++i)
+	{
+		ReaSample* buf = reg->GetBuffer(true, i);
+		if (buf != nullptr)
+			self->measureChannel(self->m_outputs[i], buf, len, truepeak);
+	}
+	self->m_accumulated_samples += len;
+	if (self->m_accumulated_samples >= srate * 0.03)
+		self->publish(srate);
+	self->m_hook_ticks += Time::getHighResolutionTicks() - t0;
+	if (len > 0 && srate > 0.0)
+	{
+		float load = (float)(Time::highResolutionTicksToSeconds(self->m_hook_ticks) * srate / len);
+		self->m_load_sum += load;
+		self->m_load_max = jmax(self->m_load_max, load);
+		++self->m_num_buffers;
+	}
+}
+
+void AudioMeterEngine::publish(double srate)
+{
+	m_frame.m_num_inputs = m_num_inputs;
+	m_frame.m_num_outputs = m_num_outputs;
+	m_frame.m_samplerate = srate;
+	m_frame.m_load_avg = m_num_buffers > 0 ? (float)(m_load_sum / m_num_buffers) : 0.0f;
+	m_frame.m_load_max = m_load_max;
+	bool truepeak = m_true_peak_enabled.load(std::memory_order_relaxed);
+	auto fill = [this, truepeak](ChannelState* states, MeterChannelValues* values, int num)
+	{
+		for (int i = 0; i < num; ++i)
+		{
+			ChannelState& st = states[i];
+			values[i].m_peak = (float)st.m_peak;
+			values[i].m_rms = (float)std::sqrt(st.m_sumsq / m_accumulated_samples);
+			// the sample values themselves are points of the oversampled signal too
+			values[i].m_true_peak = truepeak ? jmax(st.m_true_peak, (float)st.m_peak) : 0.0f;
+			st.m_peak = 0.0;
+			st.m_sumsq = 0.0;
+			st.m_true_peak = 0.0f;
+		}
+	};
+	fill(m_inputs, m_frame.m_inputs, m_num_inputs);
+	fill(m_outputs, m_frame.m_outputs, m_num_outputs);
+	if (m_queue.push(m_frame) == false)
+		++m_dropped_frames;
+	m_accumulated_samples = 0;
+	m_load_sum = 0.0;
+	m_load_max = 0.0f;
+	m_num_buffers = 0;
+}
+
+AudioMeterComponent::AudioMeterComponent()
+{
+	for (auto& hold : m_true_peak_hold)
+		std::fill(std::begin(hold), std::end(hold), 0.0f);
+	addAndMakeVisible(&m_true_peak_button);
+	m_true_peak_button.setButtonText("True peak");
+	m_true_peak_button.setToggleState(true, dontSendNotification);
+	m_true_peak_button.addListener(this);
+	addAndMakeVisible(&m_status_label);
+	startTimer(33);
+	setSize(300, 300); // need some initial size, so Juce does not assert
+}
+
+AudioMeterComponent::~AudioMeterComponent()
+{
+	m_engine.stop();
+}
+
+void AudioMeterComponent::resized()
+{
+	m_true_peak_button.setBounds(1, getHeight() - 23, 90, 22);
+	m_status_label.setBounds(m_true_peak_button.getRight() + 2, getHeight() - 23, getWidth() - m_true_peak_button.getRight() - 3, 22);
+}
+
+void AudioMeterComponent::buttonClicked(Button* but)
+{
+	if (but == &m_true_peak_button)
+		m_engine.setTruePeakEnabled(m_true_peak_button.getToggleState());
+}
+
+void AudioMeterComponent::timerCallback()
+{
+	// the hook only runs while the meters can be seen
+	if (isShowing() == true && m_engine.isRunning() == false)
+	{
+		if (m_engine.start() == false)
+			m_status_label.setText("Could not register the audio hook", dontSendNotification);
+	}
+	else if (isShowing() == false && m_engine.isRunning() == true)
+		m_engine.stop();
+	MeterFrame frame;
+	bool gotframe = false;
+	while (m_engine.popFrame(frame))
+	{
+		gotframe = true;
+		for (int i = 0; i < frame.m_num_inputs; ++i)
+			m_true_peak_hold[0][i] = jmax(m_true_peak_hold[0][i] * 0.97f, frame.m_inputs[i].m_true_peak);
+		for (int i = 0; i < frame.m_num_outputs; ++i)
+			m_true_peak_hold[1][i] = jmax(m_true_peak_hold[1][i] * 0.97f, frame.m_outputs[i].m_true_peak);
+	}
+	if (gotframe == false)
+		return;
+	m_latest = frame;
+	m_have_frame = true;
+	m_status_label.setText("Hook load avg " + String(frame.m_load_avg * 100.0f, 3) + "% max " + String(frame.m_load_max * 100.0f, 3)
+		+ "%, " + String((int64)m_engine.getNumDroppedFrames()) + " frames dropped", dontSendNotification);
+	repaint();
+}
+
+void AudioMeterComponent::paintMeter(Graphics& g, Rectangle<int> area, const String& name, const MeterChannelValues& v, float truepeakhold)
+{
+	const float mindb = -60.0f;
+	const float maxdb = 6.0f;
+	g.setColour(Colours::white);
+	g.drawText(name, area.removeFromLeft(40), Justification::centredLeft);
+	g.setColour(Colours::black);
+	g.fillRect(area);
+	auto toX = [&](float gain)
+	{
+		float db = jlimit(mindb, maxdb, Decibels::gainToDecibels(gain, mindb));
+		return area.getX() + (int)((db - mindb) / (maxdb - mindb) * area.getWidth());
+	};
+	g.setColour(Colours::green.brighter());
+	g.fillRect(area.withRight(toX(v.m_peak)));
+	g.setColour(Colours::darkgreen);
+	g.fillRect(area.withRight(toX(v.m_rms)));
+	if (m_engine.isTruePeakEnabled() == true && truepeakhold > 0.0f)
+	{
+		g.setColour(truepeakhold > 1.0f ? Colours::red : Colours::yellow);
+		g.fillRect(toX(truepeakhold) - 1, area.getY(), 2, area.getHeight());
+	}
+	g.setColour(Colours::grey);
+	g.fillRect(toX(1.0f), area.getY(), 1, area.getHeight());
+}
+
+void AudioMeterComponent::paint(Graphics& g)
+{
+	g.fillAll(Colours::darkgrey);
+	if (m_have_frame == false)
+		return;
+	const int rowh = 14;
+	int y = 2;
+	for (int i = 0; i < m_latest.m_num_inputs; ++i, y += rowh)
+		paintMeter(g, { 2, y, getWidth() - 4, rowh - 2 }, "In " + String(i + 1), m_latest.m_inputs[i], m_true_peak_hold[0][i]);
+	y += 6;
+	for (int i = 0; i < m_latest.m_num_outputs; ++i, y += rowh)
+		paintMeter(g, { 2, y, getWidth() - 4, rowh - 2 }, "Out " + String(i + 1), m_latest.m_outputs[i], m_true_peak_hold[1][i]);
+}
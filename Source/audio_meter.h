@@ -0,0 +1,105 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "reaper_plugin.h"
+#include "lockfree_queue.h"
+
+const int MaxMeterChannels = 64;
+
+struct MeterChannelValues
+{
+	float m_peak = 0.0f;
+	float m_rms = 0.0f;
+	float m_true_peak = 0.0f;
+};
+
+// Levels of all hardware channels over one publishing interval, gains not dB
+struct MeterFrame
+{
+	int m_num_inputs = 0;
+	int m_num_outputs = 0;
+	double m_samplerate = 0.0;
+	// time spent in the hook relative to the duration of the audio buffer, average and worst
+	float m_load_avg = 0.0f;
+	float m_load_max = 0.0f;
+	MeterChannelValues m_inputs[MaxMeterChannels];
+	MeterChannelValues m_outputs[MaxMeterChannels];
+};
+
+// 4x oversampling true peak detector, 48 tap windowed sinc interpolator split into 4 phases.
+// Phase 0 is the input sample itself, so only the 3 phases between samples are computed.
+class TruePeakDetector
+{
+public:
+	static const int TapsPerPhase = 12;
+	static const int HistoryLen = TapsPerPhase - 1;
+	// src must hold HistoryLen samples of history followed by len new samples
+	static float process(const float* src, int len);
+private:
+	static const float* getCoefficients();
+};
+
+// Measures peak, RMS and true peak of the hardware inputs and outputs from an audio hook
+// registered with Audio_RegHardwareHook. The hook does not allocate or lock, the results are
+// handed to the UI through a single-producer single-consumer queue about 30 times a second.
+class AudioMeterEngine
+{
+public:
+	AudioMeterEngine();
+	~AudioMeterEngine();
+	bool start();
+	void stop();
+	bool isRunning() const { return m_registered; }
+	void setTruePeakEnabled(bool b) { m_true_peak_enabled = b; }
+	bool isTruePeakEnabled() const { return m_true_peak_enabled; }
+	// Only from one thread, normally the message thread
+	bool popFrame(MeterFrame& frame) { return m_queue.pop(frame); }
+	uint64 getNumDroppedFrames() const { return m_dropped_frames.load(); }
+private:
+	static const int ChunkLen = 1024;
+	struct ChannelState
+	{
+		double m_peak = 0.0;
+		double m_sumsq = 0.0;
+		float m_true_peak = 0.0f;
+		float m_history[TruePeakDetector::HistoryLen] = { 0.0f };
+	};
+	static void onAudioBuffer(bool isPost, int len, double srate, audio_hook_register_t* reg);
+	void measureChannel(ChannelState& state, const ReaSample* buf, int len, bool truepeak);
+	void publish(double srate);
+	audio_hook_register_t m_reg;
+	bool m_registered = false;
+	ChannelState m_inputs[MaxMeterChannels];
+	ChannelState m_outputs[MaxMeterChannels];
+	float m_scratch[TruePeakDetector::HistoryLen + ChunkLen];
+	int m_num_inputs = 0;
+	int m_num_outputs = 0;
+	int m_accumulated_samples = 0;
+	int64 m_hook_ticks = 0; // spent in the current buffer's pre and post calls
+	double m_load_sum = 0.0;
+	float m_load_max = 0.0f;
+	int m_num_buffers = 0;
+	MeterFrame m_frame;
+	SPSCQueue<MeterFrame> m_queue;
+	std::atomic<bool> m_true_peak_enabled{ true };
+	std::atomic<uint64> m_dropped_frames{ 0 };
+};
+
+class AudioMeterComponent : public Component, public Button::Listener, private Timer
+{
+public:
+	AudioMeterComponent();
+	~AudioMeterComponent();
+	void paint(Graphics& g) override;
+	void resized() override;
+	void buttonClicked(Button* but) override;
+private:
+	void timerCallback() override;
+	void paintMeter(Graphics& g, Rectangle<int> area, const String& name, const MeterChannelValues& v, float truepeakhold);
+	AudioMeterEngine m_engine;
+	ToggleButton m_true_peak_button;
+	Label m_status_label;
+	MeterFrame m_latest;
+	float m_true_peak_hold[2][MaxMeterChannels];
+	bool m_have_frame = false;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "lockfree_queue.h"
+
+class MediaTrack;
+
+enum class CSurfEventType : uint16
+{
+	TrackListChange,
+	Volume,
+	Pan,
+	Mute,
+	Selected,
+	Solo,
+	RecArm,
+	PlayState,
+	RepeatState,
+	TrackTitle,
+	AutoMode,
+	ResetCachedVolPanStates,
+	TrackSelection,
+	Extended,
+	NumTypes
+};
+
+// Fixed size record of one IReaperControlSurface callback. Holds no strings or other owned
+// data, so it can be copied through lock-free queues and written to disk as is. Which of the
+// fields are meaningful depends on m_type, and for Extended on m_ext_call.
+struct CSurfEvent
+{
+	int64 m_ticks = 0; // Time::getHighResolutionTicks
+	MediaTrack* m_track = nullptr;
+	double m_values[2] = { 0.0, 0.0 };
+	int32 m_ext_call = 0; // CSURF_EXT_* code
+	int32 m_ints[2] = { 0, 0 };
+	CSurfEventType m_type = CSurfEventType::TrackListChange;
+};
+
+const char* getCSurfEventTypeName(CSurfEventType type);
+
+// Returns nullptr for CSURF_EXT_* codes that are not known
+const char* getExtendedCallName(int call);
+
+// Returns the text for an event, REAPER is queried for the current track number so this
+// must be called on the main thread
+String formatCSurfEvent(const CSurfEvent& ev);
+
+// MySurface pushes into this queue while capture is enabled, the CSurf logger drains it.
+// Events that don't fit are counted and dropped, the surface callbacks never wait.
+extern LockFreeQueue<CSurfEvent> g_csurf_event_queue;
+extern std::atomic<bool> g_csurf_capture_enabled;
+extern std::atomic<uint64> g_csurf_events_dropped;
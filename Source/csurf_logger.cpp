@@ -0,0 +1,319 @@
+#include "csurf_logger.h"
+#include "reaper_plugin_functions.h"
+#include "my_surface.h"
+
+const char* getCSurfEventTypeName(CSurfEventType type)
+{
+	switch (type)
+	{
+	case CSurfEventType::TrackListChange: return "track list change";
+	case CSurfEventType::Volume: return "volume";
+	case CSurfEventType::Pan: return "pan";
+	case CSurfEventType::Mute: return "mute";
+	case CSurfEventType::Selected: return "selected";
+	case CSurfEventType::Solo: return "solo";
+	case CSurfEventType::RecArm: return "rec arm";
+	case CSurfEventType::PlayState: return "play state";
+	case CSurfEventType::RepeatState: return "repeat";
+	case CSurfEventType::TrackTitle: return "track title";
+	case CSurfEventType::AutoMode: return "automation mode";
+	case CSurfEventType::ResetCachedVolPanStates: return "reset cached vol/pan";
+	case CSurfEventType::TrackSelection: return "track selection";
+	case CSurfEventType::Extended: return "extended";
+	default: return "unknown";
+	}
+}
+
+const char* getExtendedCallName(int call)
+{
+	switch (call)
+	{
+	case CSURF_EXT_RESET: return "reset";
+	case CSURF_EXT_SETINPUTMONITOR: return "input monitor";
+	case CSURF_EXT_SETMETRONOME: return "metronome";
+	case CSURF_EXT_SETAUTORECARM: return "auto rec arm";
+	case CSURF_EXT_SETRECMODE: return "record mode";
+	case CSURF_EXT_SETSENDVOLUME: return "send volume";
+	case CSURF_EXT_SETSENDPAN: return "send pan";
+	case CSURF_EXT_SETFXENABLED: return "fx enabled";
+	case CSURF_EXT_SETFXPARAM: return "fx param";
+	case CSURF_EXT_SETLASTTOUCHEDFX: return "last touched fx";
+	case CSURF_EXT_SETFOCUSEDFX: return "focused fx";
+	case CSURF_EXT_SETLASTTOUCHEDTRACK: return "last touched track";
+	case CSURF_EXT_SETMIXERSCROLL: return "mixer scroll";
+	case CSURF_EXT_SETBPMANDPLAYRATE: return "bpm and playrate";
+	case CSURF_EXT_SETPAN_EX: return "pan ex";
+	case CSURF_EXT_SETRECVVOLUME: return "receive volume";
+	case CSURF_EXT_SETRECVPAN: return "receive pan";
+	case CSURF_EXT_SETFXOPEN: return "fx open";
+	case CSURF_EXT_SETFXCHANGE: return "fx change";
+	case CSURF_EXT_SETPROJECTMARKERCHANGE: return "project marker change";
+	default: return nullptr;
+	}
+}
+
+String formatCSurfEvent(const CSurfEvent& ev)
+{
+	String txt = String(Time::highResolutionTicksToSeconds(ev.m_ticks), 4) + " ";
+	// the track may have been removed since the event was captured
+	if (ev.m_track != nullptr)
+	{
+		if (ValidatePtr(ev.m_track, "MediaTrack*"))
+			txt << "track " << String(CSurf_TrackToID(ev.m_track, false)) << " ";
+		else txt << "removed track ";
+	}
+	switch (ev.m_type)
+	{
+	case CSurfEventType::Volume:
+		txt << "volume " << String(Decibels::gainToDecibels(ev.m_values[0]), 2) << " dB";
+		break;
+	case CSurfEventType::Pan:
+		txt << "pan " << String(ev.m_values[0], 3);
+		break;
+	case CSurfEventType::Mute:
+	case CSurfEventType::Solo:
+	case CSurfEventType::RecArm:
+	case CSurfEventType::RepeatState:
+		txt << getCSurfEventTypeName(ev.m_type) << (ev.m_ints[0] != 0 ? " on" : " off");
+		break;
+	case CSurfEventType::Selected:
+		txt << (ev.m_ints[0] != 0 ? "selected" : "unselected");
+		break;
+	case CSurfEventType::PlayState:
+		txt << "play " << (ev.m_ints[0] & 1) << " pause " << ((ev.m_ints[0] >> 1) & 1) << " record " << ((ev.m_ints[0] >> 2) & 1);
+		break;
+	case CSurfEventType::TrackTitle:
+		// the name interned when the event was captured
+		txt << "title \"" << InternedString::fromId((uint32)ev.m_ints[0]).get() << "\"";
+		break;
+	case CSurfEventType::AutoMode:
+		txt << "automation mode " << ev.m_ints[0];
+		break;
+	case CSurfEventType::Extended:
+	{
+		const char* name = getExtendedCallName(ev.m_ext_call);
+		if (name == nullptr)
+		{
+			txt << "extended 0x" << String::toHexString(ev.m_ext_call);
+			break;
+		}
+		txt << name;
+		switch (ev.m_ext_call)
+		{
+		case CSURF_EXT_SETFXPARAM:
+			txt << " fx " << ev.m_ints[0] << " param " << ev.m_ints[1] << " = " << String(ev.m_values[0], 4);
+			break;
+		case CSURF_EXT_SETSENDVOLUME:
+		case CSURF_EXT_SETSENDPAN:
+		case CSURF_EXT_SETRECVVOLUME:
+		case CSURF_EXT_SETRECVPAN:
+			txt << " " << ev.m_ints[0] << " = " << String(ev.m_values[0], 3);
+			break;
+		case CSURF_EXT_SETFXENABLED:
+		case CSURF_EXT_SETFXOPEN:
+			txt << " fx " << ev.m_ints[0] << (ev.m_ints[1] != 0 ? " on" : " off");
+			break;
+		case CSURF_EXT_SETLASTTOUCHEDFX:
+		case CSURF_EXT_SETFOCUSEDFX:
+			txt << " fx " << ev.m_ints[0];
+			break;
+		case CSURF_EXT_SETPAN_EX:
+			txt << " mode " << ev.m_ints[0] << " " << String(ev.m_values[0], 3) << " " << String(ev.m_values[1], 3);
+			break;
+		case CSURF_EXT_SETBPMANDPLAYRATE:
+			if (ev.m_ints[0] != 0)
+				txt << " bpm " << String(ev.m_values[0], 2);
+			if (ev.m_ints[1] != 0)
+				txt << " rate " << String(ev.m_values[1], 3);
+			break;
+		case CSURF_EXT_SETMETRONOME:
+		case CSURF_EXT_SETAUTORECARM:
+			txt << (ev.m_ints[0] != 0 ? " on" : " off");
+			break;
+		case CSURF_EXT_SETINPUTMONITOR:
+		case CSURF_EXT_SETRECMODE:
+			txt << " " << ev.m_ints[0];
+			break;
+		}
+		break;
+	}
+	default:
+		txt << getCSurfEventTypeName(ev.m_type);
+		break;
+	}
+	return txt;
+}
+
+CSurfLoggerComponent::CSurfLoggerComponent() : m_stats_view(m_stats), m_events(1 << 20)
+{
+	addAndMakeVisible(&m_list);
+	m_list.setModel(this);
+	m_list.setRowHeight(18);
+	m_list.setColour(ListBox::backgroundColourId, Colours::white);
+	addAndMakeVisible(&m_status_label);
+	addAndMakeVisible(&m_record_button);
+	m_record_button.setButtonText("Record...");
+	m_record_button.setTooltip("Record the captured events into a file");
+	m_record_button.addListener(this);
+	addAndMakeVisible(&m_replay_button);
+	m_replay_button.setButtonText("Replay...");
+	m_replay_button.setTooltip("Play a recording back through the control surface callbacks");
+	m_replay_button.addListener(this);
+	addChildComponent(&m_stats_view);
+	addAndMakeVisible(&m_stats_button);
+	m_stats_button.setButtonText("Stats");
+	m_stats_button.setTooltip("Show the event rates per type and per track");
+	m_stats_button.setClickingTogglesState(true);
+	m_stats_button.addListener(this);
+	m_last_dropped = g_csurf_events_dropped.load();
+	g_csurf_capture_enabled = true;
+	startTimer(33);
+	setSize(300, 300); // need some initial size, so Juce does not assert
+}
+
+CSurfLoggerComponent::~CSurfLoggerComponent()
+{
+	g_csurf_capture_enabled = false;
+	m_recorder.stop();
+}
+
+void CSurfLoggerComponent::resized()
+{
+	m_list.setBounds(0, 0, getWidth(), getHeight() - 24);
+	m_stats_view.setBounds(m_list.getBounds());
+	m_record_button.setBounds(1, getHeight() - 23, 80, 22);
+	m_replay_button.setBounds(m_record_button.getRight() + 2, getHeight() - 23, 80, 22);
+	m_stats_button.setBounds(m_replay_button.getRight() + 2, getHeight() - 23, 60, 22);
+	m_status_label.setBounds(m_stats_button.getRight() + 2, getHeight() - 23, getWidth() - m_stats_button.getRight() - 3, 22);
+}
+
+void CSurfLoggerComponent::buttonClicked(Button* but)
+{
+	if (but == &m_stats_button)
+	{
+		m_stats_view.setVisible(m_stats_button.getToggleState());
+		m_list.setVisible(m_stats_button.getToggleState() == false);
+	}
+	if (but == &m_record_button)
+	{
+		if (m_recorder.isRecording())
+		{
+			m_recorder.stop();
+			m_record_button.setButtonText("Record...");
+			m_replay_button.setEnabled(true);
+			return;
+		}
+		FileChooser chooser("Record control surface events to...",
+			File::getSpecialLocation(File::userHomeDirectory), "*.csurflog");
+		if (chooser.browseForFileToSave(true) == false)
+			return;
+		if (m_recorder.start(chooser.getResult().withFileExtension("csurflog")))
+		{
+			m_record_button.setButtonText("Stop");
+			// replayed events would be recorded again
+			m_replay_button.setEnabled(false);
+		}
+		else ShowConsoleMsg("CSurf logger : could not create recording file\n");
+	}
+	if (but == &m_replay_button)
+	{
+		if (m_replayer != nullptr && m_replayer->isPlaying())
+		{
+			m_replayer->stop();
+			// replayed values went into the mixer state mirror too
+			g_my_surface->getMixerState().invalidateTrackList();
+			m_replay_button.setButtonText("Replay...");
+			m_record_button.setEnabled(true);
+			return;
+		}
+		startReplay();
+	}
+}
+
+void CSurfLoggerComponent::startReplay()
+{
+	if (g_my_surface == nullptr)
+		return;
+	FileChooser chooser("Replay control surface events from...",
+		File::getSpecialLocation(File::userHomeDirectory), "*.csurflog");
+	if (chooser.browseForFileToOpen() == false)
+		return;
+	PopupMenu menu;
+	menu.addItem(1, "Original speed");
+	menu.addItem(4, "4x");
+	menu.addItem(16, "16x");
+	menu.addItem(100, "As fast as possible");
+	int r = menu.show();
+	if (r == 0)
+		return;
+	double speed = r == 100 ? 0.0 : (double)r;
+	m_replayer = std::make_unique<CSurfEventReplayer>(g_my_surface);
+	m_replayer->OnFinished = [this]()
+	{
+		g_my_surface->getMixerState().invalidateTrackList();
+		m_replay_button.setButtonText("Replay...");
+		m_record_button.setEnabled(true);
+	};
+	if (m_replayer->start(chooser.getResult(), speed))
+	{
+		m_replay_button.setButtonText("Stop");
+		m_record_button.setEnabled(false);
+	}
+	else ShowConsoleMsg("CSurf logger : not a valid recording file\n");
+}
+
+int CSurfLoggerComponent::getNumRows()
+{
+	return (int)m_events.size();
+}
+
+void CSurfLoggerComponent::paintListBoxItem(int row, Graphics& g, int w, int h, bool selected)
+{
+	if (row < 0 || row >= (int)m_events.size())
+		return;
+	if (selected)
+		g.fillAll(Colours::lightblue);
+	g.setColour(Colours::black);
+	g.drawText(formatCSurfEvent(m_events[row]), 2, 0, w - 4, h, Justification::centredLeft);
+}
+
+void CSurfLoggerComponent::timerCallback()
+{
+	uint64 totalbefore = m_events.getTotalPushed();
+	CSurfEvent ev;
+	while (g_csurf_event_queue.pop(ev))
+	{
+		m_events.push(ev);
+		m_stats.addEvent(ev);
+		m_recorder.write(ev);
+	}
+	m_stats.advanceTo(Time::getHighResolutionTicks());
+	int stormcategory = m_stats.findStormCategory();
+	if (stormcategory >= 0 && m_storm_category < 0)
+		ShowConsoleMsg((String("CSurf logger : event storm of ") + CSurfRateStats::getCategoryName(stormcategory) + " events, "
+			+ String(m_stats.getCategoryRate(stormcategory).getPerSecond(), 0) + " per second\n").toRawUTF8());
+	m_storm_category = stormcategory;
+	uint64 dropped = g_csurf_events_dropped.load() - m_last_dropped;
+	String status = String((int64)m_events.getTotalPushed()) + " events, " + String((int64)dropped) + " dropped";
+	if (m_storm_category >= 0)
+		status << ", storm : " << CSurfRateStats::getCategoryName(m_storm_category);
+	if (m_storm_category >= 0)
+		m_status_label.setColour(Label::textColourId, Colours::red);
+	else m_status_label.removeColour(Label::textColourId);
+	if (m_recorder.isRecording())
+		status << ", " << String(m_recorder.getNumRecorded()) << " recorded";
+	if (m_replayer != nullptr && m_replayer->isPlaying())
+		status << ", " << String(m_replayer->getNumDispatched()) << " replayed";
+	m_status_label.setText(status, dontSendNotification);
+	if (m_stats_view.isVisible())
+		m_stats_view.repaint();
+	if (m_events.getTotalPushed() == totalbefore)
+		return;
+	// only follow the tail when the view was already showing it
+	auto& vscroll = *m_list.getVerticalScrollBar();
+	bool wasatend = vscroll.getCurrentRangeStart() + vscroll.getCurrentRangeSize() >= vscroll.getMaximumRangeLimit() - 1.0;
+	m_list.updateContent();
+	if (wasatend)
+		m_list.scrollToEnsureRowIsOnscreen(getNumRows() - 1);
+	m_list.repaint();
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "csurf_events.h"
+#include "csurf_recording.h"
+#include "csurf_stats.h"
+
+// Fixed capacity FIFO that overwrites the oldest element when full. Index 0 is the oldest element.
+template<typename T>
+class OverwritingRingBuffer
+{
+public:
+	OverwritingRingBuffer(size_t capacity) : m_data(capacity) {}
+	void push(const T& x)
+	{
+		m_data[(m_start + m_size) % m_data.size()] = x;
+		if (m_size < m_data.size())
+			++m_size;
+		else m_start = (m_start + 1) % m_data.size();
+		++m_total_pushed;
+	}
+	const T& operator[](size_t index) const { return m_data[(m_start + index) % m_data.size()]; }
+	size_t size() const { return m_size; }
+	size_t capacity() const { return m_data.size(); }
+	// including the elements that have since been overwritten
+	uint64 getTotalPushed() const { return m_total_pushed; }
+	void clear()
+	{
+		m_start = 0;
+		m_size = 0;
+	}
+private:
+	std::vector<T> m_data;
+	size_t m_start = 0;
+	size_t m_size = 0;
+	uint64 m_total_pushed = 0;
+};
+
+// Shows the control surface events captured by MySurface. The events are drained from the
+// lock-free capture queue on a timer, and only the rows that are on screen are formatted.
+class CSurfLoggerComponent : public Component, public ListBoxModel, public Button::Listener, private Timer
+{
+public:
+	CSurfLoggerComponent();
+	~CSurfLoggerComponent();
+	void resized() override;
+	int getNumRows() override;
+	void paintListBoxItem(int row, Graphics& g, int w, int h, bool selected) override;
+	void buttonClicked(Button* but) override;
+private:
+	void timerCallback() override;
+	void startReplay();
+	ListBox m_list;
+	Label m_status_label;
+	TextButton m_record_button;
+	TextButton m_replay_button;
+	TextButton m_stats_button;
+	CSurfRateStats m_stats;
+	CSurfStatsView m_stats_view;
+	int m_storm_category = -1;
+	CSurfEventRecorder m_recorder;
+	std::unique_ptr<CSurfEventReplayer> m_replayer;
+	uint64 m_last_dropped = 0;
+	OverwritingRingBuffer<CSurfEvent> m_events;
+};
@@ -0,0 +1,229 @@
+#include "csurf_recording.h"
+#include "reaper_plugin_functions.h"
+
+namespace
+{
+	const int recordingmagic = 0x474c5343; // "CSLG"
+	const int recordingversion = 1;
+	// track numbers in the file, besides the regular CSurf_TrackToID values
+	const int notrack = -1;
+	const int removedtrack = -2;
+}
+
+bool CSurfEventRecorder::start(const File& f)
+{
+	stop();
+	f.deleteFile();
+	auto out = std::make_unique<FileOutputStream>(f, 1 << 16);
+	if (out->openedOk() == false)
+		return false;
+	out->writeInt(recordingmagic);
+	out->writeInt(recordingversion);
+	out->writeInt64(Time::getHighResolutionTicksPerSecond());
+	m_out = std::move(out);
+	m_num_recorded = 0;
+	return true;
+}
+
+void CSurfEventRecorder::stop()
+{
+	if (m_out != nullptr)
+		m_out->flush();
+	m_out = nullptr;
+}
+
+void CSurfEventRecorder::write(const CSurfEvent& ev)
+{
+	if (m_out == nullptr)
+		return;
+	int tracknumber = notrack;
+	if (ev.m_track != nullptr)
+		tracknumber = ValidatePtr(ev.m_track, "MediaTrack*") ? CSurf_TrackToID(ev.m_track, false) : removedtrack;
+	// 42 bytes per event, little endian
+	m_out->writeInt64(ev.m_ticks);
+	m_out->writeInt(tracknumber);
+	m_out->writeShort((short)ev.m_type);
+	m_out->writeInt(ev.m_ext_call);
+	// track titles carry a string pool id, which means nothing in another session
+	m_out->writeInt(ev.m_type == CSurfEventType::TrackTitle ? 0 : ev.m_ints[0]);
+	m_out->writeInt(ev.m_ints[1]);
+	m_out->writeDouble(ev.m_values[0]);
+	m_out->writeDouble(ev.m_values[1]);
+	++m_num_recorded;
+}
+
+CSurfEventReplayer::~CSurfEventReplayer()
+{
+	stopTimer();
+}
+
+bool CSurfEventReplayer::start(const File& f, double speed)
+{
+	stop();
+	auto in = std::make_unique<FileInputStream>(f);
+	if (in->openedOk() == false || in->readInt() != recordingmagic || in->readInt() != recordingversion)
+		return false;
+	m_recorded_ticks_per_second = (double)in->readInt64();
+	if (m_recorded_ticks_per_second <= 0.0)
+		return false;
+	m_in = std::move(in);
+	m_speed = speed;
+	m_num_dispatched = 0;
+	m_num_skipped = 0;
+	m_has_pending = readNext();
+	m_first_ticks = m_pending.m_ticks;
+	m_start_time = Time::getMillisecondCounterHiRes();
+	startTimer(5);
+	return true;
+}
+
+void CSurfEventReplayer::stop()
+{
+	stopTimer();
+	m_in = nullptr;
+	m_has_pending = false;
+}
+
+bool CSurfEventReplayer::readNext()
+{
+	if (m_in == nullptr || m_in->getNumBytesRemaining() < 42)
+		return false;
+	m_pending.m_ticks = m_in->readInt64();
+	m_pending.m_track_number = m_in->readInt();
+	m_pending.m_type = (CSurfEventType)m_in->readShort();
+	m_pending.m_ext_call = m_in->readInt();
+	m_pending.m_ints[0] = m_in->readInt();
+	m_pending.m_ints[1] = m_in->readInt();
+	m_pending.m_values[0] = m_in->readDouble();
+	m_pending.m_values[1] = m_in->readDouble();
+	return true;
+}
+
+void CSurfEventReplayer::timerCallback()
+{
+	const double now = Time::getMillisecondCounterHiRes();
+	const double elapsedms = now - m_start_time;
+	// dense recordings or the as fast as possible mode still leave the message thread some room
+	// between ticks, events that didn't fit are dispatched late on the next tick
+	const double budgetend = now + 20.0;
+	while (m_has_pending)
+	{
+		if (m_speed > 0.0)
+		{
+			double eventms = (m_pending.m_ticks - m_first_ticks) * 1000.0 / m_recorded_ticks_per_second / m_speed;
+			if (eventms > elapsedms)
+				return;
+		}
+		if (Time::getMillisecondCounterHiRes() > budgetend)
+			return;
+		dispatch(m_pending);
+		m_has_pending = readNext();
+	}
+	stop();
+	if (OnFinished)
+		OnFinished();
+}
+
+void CSurfEventReplayer::dispatch(const RecordedEvent& rec)
+{
+	MediaTrack* track = nullptr;
+	if (rec.m_track_number == removedtrack)
+	{
+		++m_num_skipped;
+		return;
+	}
+	if (rec.m_track_number != notrack)
+	{
+		track = CSurf_TrackFromID(rec.m_track_number, false);
+		if (track == nullptr)
+		{
+			++m_num_skipped;
+			return;
+		}
+	}
+	++m_num_dispatched;
+	IReaperControlSurface* s = m_surface;
+	const bool flag = rec.m_ints[0] != 0;
+	switch (rec.m_type)
+	{
+	case CSurfEventType::TrackListChange: s->SetTrackListChange(); break;
+	case CSurfEventType::Volume: s->SetSurfaceVolume(track, rec.m_values[0]); break;
+	case CSurfEventType::Pan: s->SetSurfacePan(track, rec.m_values[0]); break;
+	case CSurfEventType::Mute: s->SetSurfaceMute(track, flag); break;
+	case CSurfEventType::Selected: s->SetSurfaceSelected(track, flag); break;
+	case CSurfEventType::Solo: s->SetSurfaceSolo(track, flag); break;
+	case CSurfEventType::RecArm: s->SetSurfaceRecArm(track, flag); break;
+	case CSurfEventType::PlayState:
+		s->SetPlayState((rec.m_ints[0] & 1) != 0, (rec.m_ints[0] & 2) != 0, (rec.m_ints[0] & 4) != 0);
+		break;
+	case CSurfEventType::RepeatState: s->SetRepeatState(flag); break;
+	case CSurfEventType::TrackTitle:
+	{
+		// titles are not recorded, the track's current name is sent instead
+		if (track == nullptr)
+			break;
+		char buf[4096];
+		buf[0] = 0;
+		GetSetMediaTrackInfo_String(track, "P_NAME", buf, false);
+		s->SetTrackTitle(track, buf);
+		break;
+	}
+	case CSurfEventType::AutoMode: s->SetAutoMode(rec.m_ints[0]); break;
+	case CSurfEventType::ResetCachedVolPanStates: s->ResetCachedVolPanStates(); break;
+	case CSurfEventType::TrackSelection: s->OnTrackSelection(track); break;
+	case CSurfEventType::Extended:
+	{
+		// rebuild the parameter pointers the same way REAPER passes them, see MySurface::Extended
+		int i0 = rec.m_ints[0];
+		int i1 = rec.m_ints[1];
+		double values[2] = { rec.m_values[0], rec.m_values[1] };
+		switch (rec.m_ext_call)
+		{
+		case CSURF_EXT_SETFXPARAM:
+		{
+			int fxparam = (i0 << 16) | (i1 & 0xffff);
+			s->Extended(rec.m_ext_call, track, &fxparam, &values[0]);
+			break;
+		}
+		case CSURF_EXT_SETSENDVOLUME:
+		case CSURF_EXT_SETSENDPAN:
+		case CSURF_EXT_SETRECVVOLUME:
+		case CSURF_EXT_SETRECVPAN:
+			s->Extended(rec.m_ext_call, track, &i0, &values[0]);
+			break;
+		case CSURF_EXT_SETFXENABLED:
+		case CSURF_EXT_SETFXOPEN:
+			s->Extended(rec.m_ext_call, track, &i0, (void*)(intptr_t)i1);
+			break;
+		case CSURF_EXT_SETLASTTOUCHEDFX:
+		case CSURF_EXT_SETFOCUSEDFX:
+			s->Extended(rec.m_ext_call, track, i1 >= 0 ? &i1 : nullptr, &i0);
+			break;
+		case CSURF_EXT_SETINPUTMONITOR:
+			s->Extended(rec.m_ext_call, track, &i0, nullptr);
+			break;
+		case CSURF_EXT_SETPAN_EX:
+			s->Extended(rec.m_ext_call, track, values, &i0);
+			break;
+		case CSURF_EXT_SETBPMANDPLAYRATE:
+			s->Extended(rec.m_ext_call, i0 != 0 ? &values[0] : nullptr, i1 != 0 ? &values[1] : nullptr, nullptr);
+			break;
+		case CSURF_EXT_SETMETRONOME:
+		case CSURF_EXT_SETAUTORECARM:
+			s->Extended(rec.m_ext_call, (void*)(intptr_t)i0, nullptr, nullptr);
+			break;
+		case CSURF_EXT_SETRECMODE:
+			s->Extended(rec.m_ext_call, &i0, nullptr, nullptr);
+			break;
+		default:
+			s->Extended(rec.m_ext_call, track, nullptr, nullptr);
+			break;
+		}
+		break;
+	}
+	default:
+		--m_num_dispatched;
+		++m_num_skipped;
+		break;
+	}
+}
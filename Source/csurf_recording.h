@@ -0,0 +1,61 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "csurf_events.h"
+
+class IReaperControlSurface;
+
+// Writes captured control surface events into a binary file. Track pointers are stored as
+// track numbers (CSurf_TrackToID), so a recording can be replayed into another session of
+// the same project. Must be used from the main thread.
+class CSurfEventRecorder
+{
+public:
+	bool start(const File& f);
+	void stop();
+	bool isRecording() const { return m_out != nullptr; }
+	void write(const CSurfEvent& ev);
+	int64 getNumRecorded() const { return m_num_recorded; }
+private:
+	std::unique_ptr<FileOutputStream> m_out;
+	int64 m_num_recorded = 0;
+};
+
+// Plays a recording back into a control surface through the regular IReaperControlSurface
+// callbacks, on the main thread like REAPER itself does. The speed is a multiplier of the
+// original timing, 0 dispatches as fast as the main thread allows.
+class CSurfEventReplayer : private Timer
+{
+public:
+	CSurfEventReplayer(IReaperControlSurface* surface) : m_surface(surface) {}
+	~CSurfEventReplayer();
+	bool start(const File& f, double speed);
+	void stop();
+	bool isPlaying() const { return m_in != nullptr; }
+	int64 getNumDispatched() const { return m_num_dispatched; }
+	int64 getNumSkipped() const { return m_num_skipped; }
+	std::function<void(void)> OnFinished;
+private:
+	struct RecordedEvent
+	{
+		int64 m_ticks = 0;
+		int m_track_number = -1;
+		CSurfEventType m_type = CSurfEventType::TrackListChange;
+		int m_ext_call = 0;
+		int m_ints[2] = { 0, 0 };
+		double m_values[2] = { 0.0, 0.0 };
+	};
+	void timerCallback() override;
+	bool readNext();
+	void dispatch(const RecordedEvent& rec);
+	IReaperControlSurface* m_surface = nullptr;
+	std::unique_ptr<FileInputStream> m_in;
+	RecordedEvent m_pending;
+	bool m_has_pending = false;
+	double m_speed = 1.0;
+	double m_recorded_ticks_per_second = 1.0;
+	int64 m_first_ticks = 0;
+	double m_start_time = 0.0;
+	int64 m_num_dispatched = 0;
+	int64 m_num_skipped = 0;
+};
@@ -0,0 +1,230 @@
+#include "csurf_stats.h"
+#include "reaper_plugin_functions.h"
+
+namespace
+{
+	// Extended calls that get their own category, anything else counts as "ext other"
+	const int knownextcalls[] =
+	{
+		CSURF_EXT_RESET, CSURF_EXT_SETINPUTMONITOR, CSURF_EXT_SETMETRONOME, CSURF_EXT_SETAUTORECARM,
+		CSURF_EXT_SETRECMODE, CSURF_EXT_SETSENDVOLUME, CSURF_EXT_SETSENDPAN, CSURF_EXT_SETFXENABLED,
+		CSURF_EXT_SETFXPARAM, CSURF_EXT_SETLASTTOUCHEDFX, CSURF_EXT_SETFOCUSEDFX, CSURF_EXT_SETLASTTOUCHEDTRACK,
+		CSURF_EXT_SETMIXERSCROLL, CSURF_EXT_SETBPMANDPLAYRATE, CSURF_EXT_SETPAN_EX, CSURF_EXT_SETRECVVOLUME,
+		CSURF_EXT_SETRECVPAN, CSURF_EXT_SETFXOPEN, CSURF_EXT_SETFXCHANGE, CSURF_EXT_SETPROJECTMARKERCHANGE
+	};
+	const int numknownextcalls = sizeof(knownextcalls) / sizeof(int);
+	const int numtypes = (int)CSurfEventType::NumTypes;
+}
+
+void CSurfRateStats::Rate::add()
+{
+	++m_buckets[0];
+	++m_window_count;
+	++m_total;
+}
+
+// Shifts the window by the given number of buckets, bucket 0 is always the current one
+void CSurfRateStats::Rate::rotate(int numbuckets)
+{
+	if (numbuckets >= NumBuckets)
+	{
+		std::fill(std::begin(m_buckets), std::end(m_buckets), 0);
+		m_window_count = 0;
+		return;
+	}
+	for (int i = NumBuckets - 1; i >= 0; --i)
+	{
+		if (i >= NumBuckets - numbuckets)
+			m_window_count -= m_buckets[i];
+		m_buckets[i] = i >= numbuckets ? m_buckets[i - numbuckets] : 0;
+	}
+}
+
+CSurfRateStats::CSurfRateStats() : m_categories(numtypes + numknownextcalls + 1)
+{
+}
+
+int CSurfRateStats::getCategory(const CSurfEvent& ev)
+{
+	if (ev.m_type != CSurfEventType::Extended)
+		return jlimit(0, numtypes - 1, (int)ev.m_type);
+	for (int i = 0; i < numknownextcalls; ++i)
+		if (knownextcalls[i] == ev.m_ext_call)
+			return numtypes + i;
+	return numtypes + numknownextcalls;
+}
+
+String CSurfRateStats::getCategoryName(int category)
+{
+	if (category < numtypes)
+		return getCSurfEventTypeName((CSurfEventType)category);
+	if (category < numtypes + numknownextcalls)
+		return String("ext ") + getExtendedCallName(knownextcalls[category - numtypes]);
+	return "ext other";
+}
+
+void CSurfRateStats::advanceTo(int64 ticks)
+{
+	int64 bucket = (int64)(Time::highResolutionTicksToSeconds(ticks) * 1000.0 / BucketMs);
+	if (m_current_bucket < 0)
+		m_current_bucket = bucket;
+	// replayed recordings can go back in time, they just land in the current bucket
+	if (bucket <= m_current_bucket)
+		return;
+	int steps = (int)jmin<int64>(bucket - m_current_bucket, NumBuckets);
+	m_current_bucket = bucket;
+	for (auto& c : m_categories)
+		c.rotate(steps);
+	m_total.rotate(steps);
+	for (auto& t : m_talkers)
+		t.m_rate.rotate(steps);
+}
+
+CSurfRateStats::Talker& CSurfRateStats::findOrReplaceTalker(MediaTrack* track, int fx)
+{
+	Talker* minimum = &m_talkers[0];
+	for (auto& t : m_talkers)
+	{
+		if (t.isUsed() && t.m_track == track && t.m_fx == fx)
+			return t;
+		if (t.isUsed() == false)
+		{
+			minimum = &t;
+			break;
+		}
+		if (t.m_rate.m_window_count < minimum->m_rate.m_window_count ||
+			(t.m_rate.m_window_count == minimum->m_rate.m_window_count && t.m_rate.m_total < minimum->m_rate.m_total))
+			minimum = &t;
+	}
+	// Space-Saving: the new key inherits the evicted counts as its error bound, here the
+	// eviction prefers the least active entry of the current window so that rates stay meaningful
+	int64 inheritedtotal = minimum->m_rate.m_total;
+	minimum->m_track = track;
+	minimum->m_fx = fx;
+	minimum->m_error = inheritedtotal;
+	minimum->m_rate = Rate();
+	minimum->m_rate.m_total = inheritedtotal;
+	return *minimum;
+}
+
+void CSurfRateStats::addEvent(const CSurfEvent& ev)
+{
+	advanceTo(ev.m_ticks);
+	m_categories[getCategory(ev)].add();
+	m_total.add();
+	if (ev.m_track != nullptr)
+	{
+		int fx = -1;
+		if (ev.m_type == CSurfEventType::Extended && ev.m_ext_call == CSURF_EXT_SETFXPARAM)
+			fx = ev.m_ints[0];
+		findOrReplaceTalker(ev.m_track, fx).m_rate.add();
+	}
+}
+
+std::vector<CSurfRateStats::Talker> CSurfRateStats::getTopTalkers(int maxcount) const
+{
+	std::vector<Talker> result;
+	for (auto& t : m_talkers)
+		if (t.isUsed())
+			result.push_back(t);
+	std::sort(result.begin(), result.end(), [](const Talker& a, const Talker& b)
+	{
+		return a.m_rate.m_window_count > b.m_rate.m_window_count;
+	});
+	if ((int)result.size() > maxcount)
+		result.resize(maxcount);
+	return result;
+}
+
+void CSurfRateStats::reset()
+{
+	for (auto& c : m_categories)
+		c = Rate();
+	m_total = Rate();
+	for (auto& t : m_talkers)
+		t = Talker();
+	m_current_bucket = -1;
+}
+
+// Returns the busiest category, or -1 when nothing is over the storm threshold
+int CSurfRateStats::findStormCategory() const
+{
+	int result = -1;
+	for (int i = 0; i < (int)m_categories.size(); ++i)
+		if (isStorm(m_categories[i]) && (result < 0 || m_categories[i].m_window_count > m_categories[result].m_window_count))
+			result = i;
+	return result;
+}
+
+CSurfStatsView::CSurfStatsView(CSurfRateStats& stats) : m_stats(stats)
+{
+	setOpaque(true);
+}
+
+void CSurfStatsView::paint(Graphics& g)
+{
+	g.fillAll(Colours::white);
+	g.setFont(14.0f);
+	const int lineh = 17;
+	int y = 2;
+	auto drawLine = [&](const String& txt, const CSurfRateStats::Rate& rate)
+	{
+		g.setColour(m_stats.isStorm(rate) ? Colours::red : Colours::black);
+		g.drawText(txt, 4, y, getWidth() / 2 - 8, lineh, Justification::centredLeft);
+		g.drawText(String(rate.getPerSecond(), 0) + "/s, burst " + String(rate.getPeakBurstPerSecond(), 0) + "/s, total " + String(rate.m_total),
+			getWidth() / 2, y, getWidth() / 2 - 4, lineh, Justification::centredLeft);
+		y += lineh;
+	};
+	auto drawHeading = [&](const String& txt)
+	{
+		y += 4;
+		g.setColour(Colours::darkgrey);
+		g.drawText(txt, 4, y, getWidth() - 8, lineh, Justification::centredLeft);
+		g.drawHorizontalLine(y + lineh - 1, 4.0f, getWidth() - 4.0f);
+		y += lineh;
+	};
+	drawHeading("Storm threshold " + String(m_stats.getStormThreshold(), 0) + " events/s (right click to change)");
+	drawLine("all events", m_stats.getTotalRate());
+	drawHeading("Event types");
+	std::vector<int> categories;
+	for (int i = 0; i < m_stats.getNumCategories(); ++i)
+		if (m_stats.getCategoryRate(i).m_total > 0)
+			categories.push_back(i);
+	std::sort(categories.begin(), categories.end(), [this](int a, int b)
+	{
+		return m_stats.getCategoryRate(a).m_window_count > m_stats.getCategoryRate(b).m_window_count;
+	});
+	for (int category : categories)
+		drawLine(CSurfRateStats::getCategoryName(category), m_stats.getCategoryRate(category));
+	drawHeading("Top tracks");
+	for (auto& talker : m_stats.getTopTalkers(16))
+	{
+		if (y > getHeight())
+			break;
+		String txt;
+		if (ValidatePtr(talker.m_track, "MediaTrack*"))
+			txt << "track " << CSurf_TrackToID(talker.m_track, false);
+		else txt << "removed track";
+		if (talker.m_fx >= 0)
+			txt << " fx " << talker.m_fx;
+		if (talker.m_error > 0)
+			txt << " (+-" << talker.m_error << ")";
+		drawLine(txt, talker.m_rate);
+	}
+}
+
+void CSurfStatsView::mouseDown(const MouseEvent& e)
+{
+	if (e.mods.isPopupMenu() == false)
+		return;
+	const int thresholds[] = { 100, 250, 500, 1000, 2500, 10000 };
+	PopupMenu menu;
+	for (int th : thresholds)
+		menu.addItem(th, String(th) + " events/s", true, (int)m_stats.getStormThreshold() == th);
+	int r = menu.show();
+	if (r > 0)
+	{
+		m_stats.setStormThreshold(r);
+		repaint();
+	}
+}
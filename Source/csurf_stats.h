@@ -0,0 +1,70 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "csurf_events.h"
+
+// Rolling event rates of the control surface traffic, in constant memory. Rates are counted in
+// 100 ms buckets over a 1 second window, per event category (event type, with the Extended
+// calls split by CSURF_EXT_* code) and per talker (track, plus the FX index for FX parameter
+// changes). Talkers are tracked with the Space-Saving heavy hitter scheme, so only the top
+// NumTalkers entries are kept no matter how many tracks and FX are active.
+class CSurfRateStats
+{
+public:
+	static const int NumBuckets = 10;
+	static const int BucketMs = 100;
+	static const int NumTalkers = 32;
+	struct Rate
+	{
+		int m_buckets[NumBuckets] = { 0 };
+		int m_window_count = 0; // sum of m_buckets
+		int64 m_total = 0;
+		void add();
+		void rotate(int newbucket);
+		double getPerSecond() const { return m_window_count; }
+		// the busiest bucket of the current window, as a per second rate
+		double getPeakBurstPerSecond() const { return *std::max_element(std::begin(m_buckets), std::end(m_buckets)) * (1000.0 / BucketMs); }
+	};
+	struct Talker
+	{
+		MediaTrack* m_track = nullptr;
+		int m_fx = -1; // -1 for events that are not about one FX
+		Rate m_rate;
+		int64 m_error = 0; // Space-Saving overestimation bound of m_rate.m_total
+		bool isUsed() const { return m_rate.m_total > 0; }
+	};
+	CSurfRateStats();
+	void addEvent(const CSurfEvent& ev);
+	// Advances the window without an event, so rates decay while the traffic is idle
+	void advanceTo(int64 ticks);
+	int getNumCategories() const { return (int)m_categories.size(); }
+	const Rate& getCategoryRate(int category) const { return m_categories[category]; }
+	static String getCategoryName(int category);
+	const Rate& getTotalRate() const { return m_total; }
+	// Talkers sorted by current rate, highest first, unused entries excluded
+	std::vector<Talker> getTopTalkers(int maxcount) const;
+	void setStormThreshold(double eventspersecond) { m_storm_threshold = eventspersecond; }
+	double getStormThreshold() const { return m_storm_threshold; }
+	bool isStorm(const Rate& r) const { return r.getPerSecond() > m_storm_threshold; }
+	int findStormCategory() const;
+	void reset();
+private:
+	static int getCategory(const CSurfEvent& ev);
+	Talker& findOrReplaceTalker(MediaTrack* track, int fx);
+	std::vector<Rate> m_categories;
+	Rate m_total;
+	Talker m_talkers[NumTalkers];
+	int64 m_current_bucket = -1; // absolute bucket number since the tick counter's epoch
+	double m_storm_threshold = 500.0;
+};
+
+// Text view of the rates, categories and talkers over the storm threshold are drawn in red
+class CSurfStatsView : public Component
+{
+public:
+	CSurfStatsView(CSurfRateStats& stats);
+	void paint(Graphics& g) override;
+	void mouseDown(const MouseEvent& e) override;
+private:
+	CSurfRateStats& m_stats;
+};
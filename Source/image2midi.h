@@ -1,33 +1,223 @@
 #pragma once
 
 #include "JuceHeader.h"
+#include "image2midi_engine.h"
+#include "midi_bulk_writer.h"
+#include "image2midi_batch.h"
+
+class Image2MIDIPreview : public Component, private Thread, private AsyncUpdater
+{
+public:
+	Image2MIDIPreview(std::shared_ptr<Image2MIDIAnalysisCache> cache) : Thread("Image2MIDI preview"), m_cache(cache)
+	{
+		setOpaque(true);
+		startThread(3);
+	}
+	~Image2MIDIPreview()
+	{
+		stopThread(2000);
+		cancelPendingUpdate();
+	}
+	void setSourceFile(File imgfile)
+	{
+		{
+			const ScopedLock locker(m_cs);
+			m_source_file = imgfile;
+			m_source_changed = true;
+		}
+		requestRender();
+	}
+	void setParameters(const Image2MIDIParams& params)
+	{
+		{
+			const ScopedLock locker(m_cs);
+			m_params = params;
+		}
+		requestRender();
+	}
+	// Returns the analysis for the currently set image and grid size, or nullptr if the
+	// render thread has not produced it yet
+	std::shared_ptr<Image2MIDICellGrid> getCellGrid()
+	{
+		const ScopedLock locker(m_cs);
+		if (m_source_changed == false && m_grid != nullptr && m_grid->m_gridsize == m_params.m_gridsize)
+			return m_grid;
+		return nullptr;
+	}
+	void paint(Graphics& g) override
+	{
+		g.fillAll(Colours::black);
+		const ScopedLock locker(m_cs);
+		if (m_rendered.isValid())
+			g.drawImageAt(m_rendered, 0, 0);
+		g.setColour(Colours::white);
+		g.drawText(String(m_rendered_notecount) + " notes", 2, 2, getWidth() - 4, 20, Justification::topRight);
+	}
+	void resized() override
+	{
+		requestRender();
+	}
+private:
+	void requestRender()
+	{
+		{
+			const ScopedLock locker(m_cs);
+			m_target_w = getWidth();
+			m_target_h = getHeight();
+			m_render_needed = true;
+		}
+		notify();
+	}
+	void run() override
+	{
+		while (threadShouldExit() == false)
+		{
+			File source;
+			Image2MIDIParams params;
+			std::shared_ptr<Image2MIDICellGrid> grid;
+			int w = 0;
+			int h = 0;
+			{
+				const ScopedLock locker(m_cs);
+				if (m_render_needed == true)
+				{
+					m_render_needed = false;
+					source = m_source_file;
+					params = m_params;
+					w = m_target_w;
+					h = m_target_h;
+					if (m_source_changed == true)
+						m_grid = nullptr;
+					grid = m_grid;
+					m_source_changed = false;
+				}
+			}
+			if (source == File() || w < 1 || h < 1)
+			{
+				wait(-1);
+				continue;
+			}
+			if (grid == nullptr || grid->m_gridsize != params.m_gridsize)
+			{
+				grid = m_cache->getOrLoad(source, params.m_gridsize);
+				const ScopedLock locker(m_cs);
+				m_grid = grid;
+			}
+			auto events = mapCellsToEvents(*grid, params);
+			Image rendered = renderPianoRoll(events, params, w, h);
+			{
+				const ScopedLock locker(m_cs);
+				m_rendered = rendered;
+				m_rendered_notecount = (int)events.m_notes.size();
+			}
+			triggerAsyncUpdate();
+		}
+	}
+	Image renderPianoRoll(const Image2MIDIEvents& events, const Image2MIDIParams& params, int w, int h)
+	{
+		Image img(Image::RGB, w, h, true, SoftwareImageType());
+		Graphics g(img);
+		g.fillAll(Colours::black);
+		const float keyh = h / 128.0f;
+		g.setColour(Colours::darkgrey.withAlpha(0.5f));
+		g.fillRect(0.0f, (127 - params.m_pitch_high)*keyh, (float)w, (params.m_pitch_high - params.m_pitch_low + 1)*keyh);
+		for (auto& note : events.m_notes)
+		{
+			float x0 = (float)(w / params.m_length_ppq*note.m_start_ppq);
+			float x1 = (float)(w / params.m_length_ppq*note.m_end_ppq);
+			g.setColour(Colours::yellow.withMultipliedBrightness(0.2f + 0.8f * note.m_velocity / 127.0f));
+			g.fillRect(x0, (127 - note.m_pitch)*keyh, jmax(1.0f, x1 - x0), jmax(1.0f, keyh));
+		}
+		// CC lanes as step lines over the whole height, each lane in its own colour
+		for (size_t j = 0; j < params.m_cc_lanes.size(); ++j)
+		{
+			Path lane;
+			bool started = false;
+			float lasty = 0.0f;
+			for (auto& cc : events.m_ccs)
+			{
+				if (cc.m_cc != params.m_cc_lanes[j].m_cc)
+					continue;
+				float x = (float)(w / params.m_length_ppq*cc.m_ppq);
+				float y = h - h * cc.m_value / 127.0f;
+				if (started == false)
+					lane.startNewSubPath(x, y);
+				else
+				{
+					lane.lineTo(x, lasty);
+					lane.lineTo(x, y);
+				}
+				started = true;
+				lasty = y;
+			}
+			if (started == true)
+				lane.lineTo((float)w, lasty);
+			g.setColour(Colour::fromHSV(j / (float)Image2MIDIMaxCCLanes, 0.8f, 1.0f, 0.8f));
+			g.strokePath(lane, PathStrokeType(1.0f));
+		}
+		return img;
+	}
+	void handleAsyncUpdate() override
+	{
+		repaint();
+	}
+	std::shared_ptr<Image2MIDIAnalysisCache> m_cache;
+	CriticalSection m_cs;
+	File m_source_file;
+	Image2MIDIParams m_params;
+	std::shared_ptr<Image2MIDICellGrid> m_grid;
+	bool m_source_changed = false;
+	bool m_render_needed = false;
+	int m_target_w = 0;
+	int m_target_h = 0;
+	Image m_rendered;
+	int m_rendered_notecount = 0;
+};
 
 class Image2MIDIGUI : public Component, public Slider::Listener, public Button::Listener
 {
 public:
-	Image2MIDIGUI()
+	Image2MIDIGUI() :
+		m_cache(std::make_shared<Image2MIDIAnalysisCache>(File(CharPointer_UTF8(GetResourcePath())).getChildFile("juce_image2midi_cache"))),
+		m_preview(m_cache)
 	{
 		addAndMakeVisible(&m_import_button);
 		m_import_button.setButtonText("Import image...");
 		m_import_button.addListener(this);
+		addAndMakeVisible(&m_apply_button);
+		m_apply_button.setButtonText("Apply");
+		m_apply_button.setTooltip("Write the previewed notes into the active take of the first selected item");
+		m_apply_button.addListener(this);
+		addAndMakeVisible(&m_batch_button);
+		m_batch_button.setButtonText("Batch...");
+		m_batch_button.setTooltip("Convert a folder of frames into consecutive MIDI items on the first selected track, starting at the edit cursor");
+		m_batch_button.addListener(this);
+		addAndMakeVisible(&m_mapping_button);
+		m_mapping_button.setButtonText("Mapping...");
+		m_mapping_button.setTooltip("Choose which cell channels drive velocity, note length and CC lanes");
+		m_mapping_button.addListener(this);
 		addAndMakeVisible(&m_brightness_th_slider);
 		m_brightness_th_slider.addListener(this);
 		m_brightness_th_slider.setRange(0.0, 0.99);
 		m_brightness_th_slider.setValue(0.5);
+		m_brightness_th_slider.setTooltip("Brightness threshold");
+		addAndMakeVisible(&m_gridsize_slider);
+		m_gridsize_slider.addListener(this);
+		m_gridsize_slider.setRange(2.0, 64.0, 1.0);
+		m_gridsize_slider.setValue(16.0);
+		m_gridsize_slider.setTooltip("Grid size (pixels)");
+		addAndMakeVisible(&m_pitch_range_slider);
+		m_pitch_range_slider.setSliderStyle(Slider::TwoValueHorizontal);
+		m_pitch_range_slider.addListener(this);
+		m_pitch_range_slider.setRange(0.0, 127.0, 1.0);
+		m_pitch_range_slider.setMinAndMaxValues(0.0, 127.0);
+		m_pitch_range_slider.setTooltip("Pitch range");
+		addAndMakeVisible(&m_preview);
 		setSize(400, 400);
 	}
 	void sliderValueChanged(Slider* slid) override
 	{
-		
-	}
-	void sliderDragEnded(Slider* slid) override
-	{
-		MediaItem* item = GetSelectedMediaItem(nullptr, 0);
-		MediaItem_Take* take = GetActiveTake(item);
-		if (slid == &m_brightness_th_slider)
-		{
-			generateMIDI(take, m_source_image, m_brightness_th_slider.getValue());
-		}
+		m_preview.setParameters(getParameters());
 	}
 	void buttonClicked(Button* but) override
 	{
@@ -39,69 +229,158 @@ public:
 			if (myChooser.browseForFileToOpen())
 			{
 				File imgfile(myChooser.getResult());
-				Image img = ImageFileFormat::loadFrom(imgfile);
-				if (img.isValid())
+				if (canLoadImage2MIDIFile(imgfile))
 				{
-					m_source_image = img;
-					MediaItem* item = GetSelectedMediaItem(nullptr, 0);
-					MediaItem_Take* take = GetActiveTake(item);
-					generateMIDI(take,m_source_image, m_brightness_th_slider.getValue());
+					m_source_file = imgfile;
+					m_preview.setSourceFile(m_source_file);
 				}
 				else ShowConsoleMsg("Image file not valid\n");
 			}
 		}
+		if (but == &m_apply_button)
+		{
+			MediaItem* item = GetSelectedMediaItem(nullptr, 0);
+			MediaItem_Take* take = GetActiveTake(item);
+			generateMIDI(take, getParameters());
+		}
+		if (but == &m_batch_button)
+			startBatchConversion();
+		if (but == &m_mapping_button)
+			showMappingMenu();
 	}
 	void resized() override
 	{
 		m_import_button.setTopLeftPosition(1, 1);
 		m_import_button.changeWidthToFitText(20);
+		m_apply_button.setTopLeftPosition(m_import_button.getRight() + 2, 1);
+		m_apply_button.changeWidthToFitText(20);
+		m_batch_button.setTopLeftPosition(m_apply_button.getRight() + 2, 1);
+		m_batch_button.changeWidthToFitText(20);
+		m_mapping_button.setTopLeftPosition(m_batch_button.getRight() + 2, 1);
+		m_mapping_button.changeWidthToFitText(20);
 		m_brightness_th_slider.setBounds(1, m_import_button.getBottom() + 2, getWidth() - 1, 20);
+		m_gridsize_slider.setBounds(1, m_brightness_th_slider.getBottom() + 2, getWidth() - 1, 20);
+		m_pitch_range_slider.setBounds(1, m_gridsize_slider.getBottom() + 2, getWidth() - 1, 20);
+		m_preview.setBounds(1, m_pitch_range_slider.getBottom() + 2, getWidth() - 2, getHeight() - m_pitch_range_slider.getBottom() - 3);
 	}
-	void generateMIDI(MediaItem_Take* take, Image& img, float brightnessth)	
+	Image2MIDIParams getParameters() const
 	{
-		if (take == nullptr || img.isValid() == false)
-			return;
-		int cnt1, cnt2, cnt3 = 0;
-		MIDI_CountEvts(take, &cnt1, &cnt2, &cnt3);
-		if (cnt1 > 0)
+		Image2MIDIParams params;
+		params.m_brightness_th = (float)m_brightness_th_slider.getValue();
+		params.m_gridsize = (int)m_gridsize_slider.getValue();
+		params.m_pitch_low = (int)m_pitch_range_slider.getMinValue();
+		params.m_pitch_high = (int)m_pitch_range_slider.getMaxValue();
+		params.m_velocity = m_velocity_mapping;
+		params.m_note_length = m_note_length_mapping;
+		params.m_cc_lanes = m_cc_lanes;
+		return params;
+	}
+	void showMappingMenu()
+	{
+		const int numsources = (int)Image2MIDISource::NumSources;
+		PopupMenu menu;
+		PopupMenu velmenu;
+		PopupMenu lenmenu;
+		for (int i = 0; i < numsources; ++i)
 		{
-			for (int i = cnt1; i >= 0; --i)
-			{
-				MIDI_DeleteNote(take, i);
-			}
+			velmenu.addItem(100 + i, getImage2MIDISourceName((Image2MIDISource)i), true, (int)m_velocity_mapping.m_source == i);
+			lenmenu.addItem(200 + i, getImage2MIDISourceName((Image2MIDISource)i), true, (int)m_note_length_mapping.m_source == i);
+		}
+		menu.addSubMenu("Velocity", velmenu, true);
+		menu.addSubMenu("Note length", lenmenu, true);
+		menu.addSectionHeader("CC lanes");
+		const int cclanechoices[] = { 1, 2, 7, 10, 11, 74 };
+		for (int k = 0; k < 6; ++k)
+		{
+			int cc = cclanechoices[k];
+			auto it = std::find_if(m_cc_lanes.begin(), m_cc_lanes.end(), [cc](const Image2MIDICCLane& l) { return l.m_cc == cc; });
+			PopupMenu lanemenu;
+			lanemenu.addItem(1000 + k * 20, "Off", true, it == m_cc_lanes.end());
+			// Constant is not offered, a flat CC lane carries no information from the image
+			for (int i = 1; i < numsources; ++i)
+				lanemenu.addItem(1000 + k * 20 + i, getImage2MIDISourceName((Image2MIDISource)i), true,
+					it != m_cc_lanes.end() && (int)it->m_mapping.m_source == i);
+			menu.addSubMenu("CC " + String(cc), lanemenu, it != m_cc_lanes.end() || m_cc_lanes.size() < Image2MIDIMaxCCLanes,
+				Image(), it != m_cc_lanes.end());
 		}
-		int w = img.getWidth();
-		int h = img.getHeight();
-		int gridsize = 16;
-		int notecount = 0;
-		bool stopadding = false;
-		bool nosort = true;
-		for (int x = 0; x < w / gridsize; ++x)
+		int r = menu.show();
+		if (r >= 100 && r < 100 + numsources)
+			m_velocity_mapping.m_source = (Image2MIDISource)(r - 100);
+		if (r >= 200 && r < 200 + numsources)
+			m_note_length_mapping.m_source = (Image2MIDISource)(r - 200);
+		if (r >= 1000 && r < 1000 + 6 * 20)
 		{
-			double notepos = 4000.0 / w*(x*gridsize);
-			for (int y = 0; y < h / gridsize; ++y)
+			int cc = cclanechoices[(r - 1000) / 20];
+			int src = (r - 1000) % 20;
+			m_cc_lanes.erase(std::remove_if(m_cc_lanes.begin(), m_cc_lanes.end(),
+				[cc](const Image2MIDICCLane& l) { return l.m_cc == cc; }), m_cc_lanes.end());
+			if (src > 0)
 			{
-				auto pix = img.getPixelAt(x*gridsize, y*gridsize);
-				if (pix.getBrightness() > brightnessth)
-				{
-					double pitch = 127.0-(127.0 / h*(y*gridsize));
-					++notecount;
-					if (notecount > 5000)
-						stopadding = true;
-					MIDI_InsertNote(take, false, false, notepos, notepos + 50.0, 1, pitch, 127, &nosort);
-				}
+				Image2MIDICCLane lane;
+				lane.m_cc = cc;
+				lane.m_mapping = { (Image2MIDISource)src, 0.0f, 127.0f };
+				m_cc_lanes.push_back(lane);
 			}
-			if (stopadding == true)
-				break;
 		}
-		MIDI_Sort(take);
+		if (r > 0)
+			m_preview.setParameters(getParameters());
+	}
+	void startBatchConversion()
+	{
+		MediaTrack* track = GetSelectedTrack(nullptr, 0);
+		if (track == nullptr)
+		{
+			ShowConsoleMsg("Image2MIDI batch : no track selected\n");
+			return;
+		}
+		FileChooser myChooser("Please select folder of image frames...",
+			File::getSpecialLocation(File::userHomeDirectory));
+		if (myChooser.browseForDirectory() == false)
+			return;
+		Array<File> frames = Image2MIDIBatchConverter::findFrameFiles(myChooser.getResult());
+		if (frames.size() == 0)
+		{
+			ShowConsoleMsg("Image2MIDI batch : no image files found\n");
+			return;
+		}
+		double startqn = TimeMap2_timeToQN(nullptr, GetCursorPosition());
+		m_batch = std::make_unique<Image2MIDIBatchConverter>(frames, track, startqn, 4.0, getParameters(), m_cache);
+		m_batch->OnFinished = [this]() { m_batch_button.setEnabled(true); };
+		m_batch_button.setEnabled(false);
+		m_batch->start();
+	}
+	void generateMIDI(MediaItem_Take* take, const Image2MIDIParams& params)
+	{
+		if (take == nullptr || m_source_file == File())
+			return;
+		auto grid = m_preview.getCellGrid();
+		if (grid == nullptr)
+			grid = m_cache->getOrLoad(m_source_file, params.m_gridsize);
+		auto events = mapCellsToEvents(*grid, params);
+		MIDIBulkWriter writer;
+		for (auto& note : events.m_notes)
+			writer.addNote(note.m_start_ppq, note.m_end_ppq, params.m_midi_channel, note.m_pitch, note.m_velocity);
+		for (auto& cc : events.m_ccs)
+			writer.addCC(cc.m_ppq, 0xb0, params.m_midi_channel, cc.m_cc, cc.m_value);
+		writer.replaceTakeEvents(take);
 		UpdateArrange();
 		char buf[100];
-		sprintf(buf, "Added %d notes\n", notecount);
+		sprintf(buf, "Added %d notes, %d CCs\n", (int)events.m_notes.size(), (int)events.m_ccs.size());
 		ShowConsoleMsg(buf);
 	}
 private:
 	TextButton m_import_button;
-	Image m_source_image;
+	TextButton m_apply_button;
+	TextButton m_batch_button;
+	TextButton m_mapping_button;
+	Image2MIDIMapping m_velocity_mapping{ Image2MIDISource::Constant, 1.0f, 127.0f };
+	Image2MIDIMapping m_note_length_mapping{ Image2MIDISource::Constant, 10.0f, 50.0f };
+	std::vector<Image2MIDICCLane> m_cc_lanes;
+	File m_source_file;
 	Slider m_brightness_th_slider;
+	Slider m_gridsize_slider;
+	Slider m_pitch_range_slider;
+	std::shared_ptr<Image2MIDIAnalysisCache> m_cache;
+	Image2MIDIPreview m_preview;
+	std::unique_ptr<Image2MIDIBatchConverter> m_batch;
 };
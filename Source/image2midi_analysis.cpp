@@ -0,0 +1,215 @@
+#include "image2midi_analysis.h"
+
+#if JUCE_INTEL
+#include <emmintrin.h>
+#endif
+
+const char* getImage2MIDISourceName(Image2MIDISource src)
+{
+	switch (src)
+	{
+	case Image2MIDISource::Constant: return "Constant";
+	case Image2MIDISource::Brightness: return "Brightness";
+	case Image2MIDISource::Red: return "Red";
+	case Image2MIDISource::Green: return "Green";
+	case Image2MIDISource::Blue: return "Blue";
+	case Image2MIDISource::Hue: return "Hue";
+	case Image2MIDISource::Saturation: return "Saturation";
+	default: return "";
+	}
+}
+
+namespace
+{
+	const int numsources = (int)Image2MIDISource::NumSources;
+
+	// Same definitions as Colour::getBrightness, getSaturation and getHue
+	inline void computeSources(float r, float g, float b, float* ch)
+	{
+		float mx = jmax(r, g, b);
+		float mn = jmin(r, g, b);
+		float d = mx - mn;
+		float hue = 0.0f;
+		if (d > 0.0f)
+		{
+			if (mx == r)
+				hue = (g - b) / d;
+			else if (mx == g)
+				hue = 2.0f + (b - r) / d;
+			else hue = 4.0f + (r - g) / d;
+			hue /= 6.0f;
+			if (hue < 0.0f)
+				hue += 1.0f;
+		}
+		ch[(int)Image2MIDISource::Constant] = 1.0f;
+		ch[(int)Image2MIDISource::Brightness] = mx;
+		ch[(int)Image2MIDISource::Red] = r;
+		ch[(int)Image2MIDISource::Green] = g;
+		ch[(int)Image2MIDISource::Blue] = b;
+		ch[(int)Image2MIDISource::Hue] = hue;
+		ch[(int)Image2MIDISource::Saturation] = mx > 0.0f ? d / mx : 0.0f;
+	}
+
+#if JUCE_INTEL
+	inline __m128 selectPS(__m128 mask, __m128 a, __m128 b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	// 4 cell version of computeSources
+	inline void computeSources4(__m128 r, __m128 g, __m128 b, __m128* ch)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 tiny = _mm_set1_ps(1.0e-12f);
+		__m128 mx = _mm_max_ps(r, _mm_max_ps(g, b));
+		__m128 mn = _mm_min_ps(r, _mm_min_ps(g, b));
+		__m128 d = _mm_sub_ps(mx, mn);
+		__m128 safed = _mm_max_ps(d, tiny);
+		__m128 hr = _mm_div_ps(_mm_sub_ps(g, b), safed);
+		__m128 hg = _mm_add_ps(_mm_set1_ps(2.0f), _mm_div_ps(_mm_sub_ps(b, r), safed));
+		__m128 hb = _mm_add_ps(_mm_set1_ps(4.0f), _mm_div_ps(_mm_sub_ps(r, g), safed));
+		__m128 hue = selectPS(_mm_cmpeq_ps(mx, r), hr, selectPS(_mm_cmpeq_ps(mx, g), hg, hb));
+		hue = _mm_mul_ps(hue, _mm_set1_ps(1.0f / 6.0f));
+		hue = _mm_add_ps(hue, _mm_and_ps(_mm_cmplt_ps(hue, zero), _mm_set1_ps(1.0f)));
+		hue = _mm_and_ps(_mm_cmpgt_ps(d, zero), hue);
+		__m128 sat = _mm_and_ps(_mm_cmpgt_ps(mx, zero), _mm_div_ps(d, _mm_max_ps(mx, tiny)));
+		ch[(int)Image2MIDISource::Constant] = _mm_set1_ps(1.0f);
+		ch[(int)Image2MIDISource::Brightness] = mx;
+		ch[(int)Image2MIDISource::Red] = r;
+		ch[(int)Image2MIDISource::Green] = g;
+		ch[(int)Image2MIDISource::Blue] = b;
+		ch[(int)Image2MIDISource::Hue] = hue;
+		ch[(int)Image2MIDISource::Saturation] = sat;
+	}
+
+	inline float horizontalSum(__m128 v)
+	{
+		__m128 shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+		__m128 sums = _mm_add_ps(v, shuf);
+		shuf = _mm_movehl_ps(shuf, sums);
+		return _mm_cvtss_f32(_mm_add_ss(sums, shuf));
+	}
+#endif
+}
+
+void computeImage2MIDICellMappings(const Image2MIDICellGrid& grid, const Image2MIDIParams& params, Image2MIDICellMappings& result)
+{
+	const int cols = grid.m_cols;
+	const int rows = grid.m_rows;
+	const int numcells = cols * rows;
+	const int numlanes = jmin((int)params.m_cc_lanes.size(), Image2MIDIMaxCCLanes);
+	result.m_velocity.resize(numcells);
+	result.m_note_length.resize(numcells);
+	result.m_gate.resize(numcells);
+	result.m_cc_values.assign(numlanes * cols, 0.0f);
+	if (numcells == 0)
+		return;
+	const int velsrc = (int)params.m_velocity.m_source;
+	const float velmin = params.m_velocity.m_min;
+	const float velrange = params.m_velocity.m_max - velmin;
+	const int lensrc = (int)params.m_note_length.m_source;
+	const float lenmin = params.m_note_length.m_min;
+	const float lenrange = params.m_note_length.m_max - lenmin;
+	int lanesrc[Image2MIDIMaxCCLanes];
+	for (int i = 0; i < numlanes; ++i)
+		lanesrc[i] = (int)params.m_cc_lanes[i].m_mapping.m_source;
+	const float* rplane = grid.m_red.data();
+	const float* gplane = grid.m_green.data();
+	const float* bplane = grid.m_blue.data();
+	float* velout = result.m_velocity.data();
+	float* lenout = result.m_note_length.data();
+	uint8* gateout = result.m_gate.data();
+	for (int x = 0; x < cols; ++x)
+	{
+		float lanesums[Image2MIDIMaxCCLanes] = { 0.0f };
+		int i = x * rows;
+		const int colend = i + rows;
+#if JUCE_INTEL
+		const __m128 th4 = _mm_set1_ps(params.m_brightness_th);
+		const __m128 velmin4 = _mm_set1_ps(velmin);
+		const __m128 velrange4 = _mm_set1_ps(velrange);
+		const __m128 lenmin4 = _mm_set1_ps(lenmin);
+		const __m128 lenrange4 = _mm_set1_ps(lenrange);
+		__m128 lanesums4[Image2MIDIMaxCCLanes];
+		for (int j = 0; j < numlanes; ++j)
+			lanesums4[j] = _mm_setzero_ps();
+		__m128 ch[numsources];
+		for (; i + 4 <= colend; i += 4)
+		{
+			computeSources4(_mm_loadu_ps(rplane + i), _mm_loadu_ps(gplane + i), _mm_loadu_ps(bplane + i), ch);
+			_mm_storeu_ps(velout + i, _mm_add_ps(velmin4, _mm_mul_ps(ch[velsrc], velrange4)));
+			_mm_storeu_ps(lenout + i, _mm_add_ps(lenmin4, _mm_mul_ps(ch[lensrc], lenrange4)));
+			int gatebits = _mm_movemask_ps(_mm_cmpgt_ps(ch[(int)Image2MIDISource::Brightness], th4));
+			gateout[i + 0] = (uint8)(gatebits & 1);
+			gateout[i + 1] = (uint8)((gatebits >> 1) & 1);
+			gateout[i + 2] = (uint8)((gatebits >> 2) & 1);
+			gateout[i + 3] = (uint8)((gatebits >> 3) & 1);
+			for (int j = 0; j < numlanes; ++j)
+				lanesums4[j] = _mm_add_ps(lanesums4[j], ch[lanesrc[j]]);
+		}
+		for (int j = 0; j < numlanes; ++j)
+			lanesums[j] = horizontalSum(lanesums4[j]);
+#endif
+		// remaining cells of the column, or all of them without SSE
+		float chs[numsources];
+		for (; i < colend; ++i)
+		{
+			computeSources(rplane[i], gplane[i], bplane[i], chs);
+			velout[i] = velmin + chs[velsrc] * velrange;
+			lenout[i] = lenmin + chs[lensrc] * lenrange;
+			gateout[i] = chs[(int)Image2MIDISource::Brightness] > params.m_brightness_th ? 1 : 0;
+			for (int j = 0; j < numlanes; ++j)
+				lanesums[j] += chs[lanesrc[j]];
+		}
+		for (int j = 0; j < numlanes; ++j)
+		{
+			const Image2MIDIMapping& m = params.m_cc_lanes[j].m_mapping;
+			result.m_cc_values[j * cols + x] = m.m_min + lanesums[j] / rows * (m.m_max - m.m_min);
+		}
+	}
+}
+
+Image2MIDIEvents mapCellsToEvents(const Image2MIDICellGrid& grid, const Image2MIDIParams& params, int maxnotes)
+{
+	Image2MIDIEvents events;
+	if (grid.m_cols == 0 || grid.m_rows == 0)
+		return events;
+	Image2MIDICellMappings mapped;
+	computeImage2MIDICellMappings(grid, params, mapped);
+	const int numlanes = jmin((int)params.m_cc_lanes.size(), Image2MIDIMaxCCLanes);
+	int lastccvalue[Image2MIDIMaxCCLanes];
+	for (int j = 0; j < numlanes; ++j)
+		lastccvalue[j] = -1;
+	double pitchrange = params.m_pitch_high - params.m_pitch_low;
+	for (int x = 0; x < grid.m_cols; ++x)
+	{
+		double notepos = params.m_length_ppq / grid.m_image_w*(x*grid.m_gridsize);
+		for (int y = 0; y < grid.m_rows; ++y)
+		{
+			int i = x * grid.m_rows + y;
+			if (mapped.m_gate[i] != 0)
+			{
+				Image2MIDINote note;
+				note.m_start_ppq = notepos;
+				note.m_end_ppq = notepos + jmax(1.0f, mapped.m_note_length[i]);
+				note.m_pitch = (int)(params.m_pitch_high - (pitchrange / grid.m_image_h*(y*grid.m_gridsize)));
+				note.m_velocity = jlimit(1, 127, roundToInt(mapped.m_velocity[i]));
+				events.m_notes.push_back(note);
+			}
+		}
+		// a lane only gets a new event when its value changes
+		for (int j = 0; j < numlanes; ++j)
+		{
+			int value = jlimit(0, 127, roundToInt(mapped.m_cc_values[j * grid.m_cols + x]));
+			if (value != lastccvalue[j])
+			{
+				events.m_ccs.push_back({ notepos, params.m_cc_lanes[j].m_cc, value });
+				lastccvalue[j] = value;
+			}
+		}
+		// like before, the column that crosses the limit is still completed
+		if ((int)events.m_notes.size() > maxnotes)
+			break;
+	}
+	return events;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "JuceHeader.h"
+
+// Cell channels that can drive the MIDI output
+enum class Image2MIDISource
+{
+	Constant,
+	Brightness,
+	Red,
+	Green,
+	Blue,
+	Hue,
+	Saturation,
+	NumSources
+};
+
+const char* getImage2MIDISourceName(Image2MIDISource src);
+
+// Maps a 0..1 cell channel value linearly into m_min..m_max. Constant always yields m_max.
+struct Image2MIDIMapping
+{
+	Image2MIDIMapping() {}
+	Image2MIDIMapping(Image2MIDISource src, float minval, float maxval) :
+		m_source(src), m_min(minval), m_max(maxval) {}
+	Image2MIDISource m_source = Image2MIDISource::Constant;
+	float m_min = 0.0f;
+	float m_max = 1.0f;
+};
+
+struct Image2MIDICCLane
+{
+	int m_cc = 1;
+	Image2MIDIMapping m_mapping{ Image2MIDISource::Brightness, 0.0f, 127.0f };
+};
+
+const int Image2MIDIMaxCCLanes = 8;
+
+struct Image2MIDIParams
+{
+	float m_brightness_th = 0.5f;
+	int m_gridsize = 16;
+	int m_pitch_low = 0;
+	int m_pitch_high = 127;
+	double m_length_ppq = 4000.0; // the image width is spread over this many ticks
+	int m_midi_channel = 1; // 0 based
+	Image2MIDIMapping m_velocity{ Image2MIDISource::Constant, 1.0f, 127.0f };
+	Image2MIDIMapping m_note_length{ Image2MIDISource::Constant, 10.0f, 50.0f }; // in ticks
+	std::vector<Image2MIDICCLane> m_cc_lanes; // at most Image2MIDIMaxCCLanes, one value per grid column
+};
+
+struct Image2MIDINote
+{
+	double m_start_ppq = 0.0;
+	double m_end_ppq = 0.0;
+	int m_pitch = 0;
+	int m_velocity = 127;
+};
+
+struct Image2MIDICC
+{
+	double m_ppq = 0.0;
+	int m_cc = 0;
+	int m_value = 0;
+};
+
+struct Image2MIDIEvents
+{
+	std::vector<Image2MIDINote> m_notes;
+	std::vector<Image2MIDICC> m_ccs;
+};
+
+// Per-cell analysis of the source image. Only depends on the image and the grid size,
+// so it can be reused while the threshold, pitch range and mappings are being adjusted.
+class Image2MIDICellGrid
+{
+public:
+	int m_image_w = 0;
+	int m_image_h = 0;
+	int m_gridsize = 0;
+	int m_cols = 0;
+	int m_rows = 0;
+	// Averaged cell colour as separate 0..1 planes, column major, m_cols * m_rows entries each
+	std::vector<float> m_red;
+	std::vector<float> m_green;
+	std::vector<float> m_blue;
+	void resize(int cols, int rows)
+	{
+		m_cols = cols;
+		m_rows = rows;
+		m_red.assign(cols*rows, 0.0f);
+		m_green.assign(cols*rows, 0.0f);
+		m_blue.assign(cols*rows, 0.0f);
+	}
+};
+
+// Output of the mapping kernel, one entry per cell in grid order unless noted
+struct Image2MIDICellMappings
+{
+	std::vector<float> m_velocity;
+	std::vector<float> m_note_length;
+	std::vector<uint8> m_gate; // 1 when the cell brightness is above the threshold
+	std::vector<float> m_cc_values; // lane * m_cols + column, mean of the column
+};
+
+// Derives every mapped output from the colour planes in a single pass over the grid
+void computeImage2MIDICellMappings(const Image2MIDICellGrid& grid, const Image2MIDIParams& params, Image2MIDICellMappings& result);
+
+// Shared by the preview and the take writer so that what is shown is exactly what gets written
+Image2MIDIEvents mapCellsToEvents(const Image2MIDICellGrid& grid, const Image2MIDIParams& params, int maxnotes = 5000);
@@ -0,0 +1,129 @@
+#include "image2midi_batch.h"
+#include "midi_bulk_writer.h"
+#include "reaper_plugin_functions.h"
+
+Image2MIDIBatchConverter::Image2MIDIBatchConverter(Array<File> frames, MediaTrack* track, double startqn, double frameqn, Image2MIDIParams params,
+	std::shared_ptr<Image2MIDIAnalysisCache> cache)
+	: m_cache(cache), m_track(track), m_start_qn(startqn), m_frame_qn(frameqn), m_params(params),
+	m_tasks(*g_task_pool, "Image2MIDI frame", TaskPriority::Batch)
+{
+	for (auto& f : frames)
+	{
+		auto slot = std::make_unique<FrameSlot>();
+		slot->m_file = f;
+		m_slots.push_back(std::move(slot));
+	}
+}
+
+Image2MIDIBatchConverter::~Image2MIDIBatchConverter()
+{
+	m_tasks.cancel();
+	m_tasks.wait();
+}
+
+void Image2MIDIBatchConverter::start()
+{
+	m_start_time = Time::getMillisecondCounterHiRes();
+	// jobs are queued in frame order, so the frames that get committed first are also analysed first
+	for (auto& slot : m_slots)
+	{
+		FrameSlot* s = slot.get();
+		m_tasks.add([this, s]()
+		{
+			s->m_grid = m_cache->getOrLoad(s->m_file, m_params.m_gridsize);
+			s->m_ready = true;
+			postCommit();
+		});
+	}
+}
+
+void Image2MIDIBatchConverter::postCommit()
+{
+	if (m_commit_posted.exchange(true) == true)
+		return;
+	if (m_main_thread.post([this]() { commitReadyFrames(); }) == false)
+		m_commit_posted = false; // the next finished frame tries again
+}
+
+Array<File> Image2MIDIBatchConverter::findFrameFiles(const File& folder)
+{
+	Array<File> result = folder.findChildFiles(File::findFiles, false, "*.png;*.jpg;*.jpeg");
+	// natural order, so that frame_2 comes before frame_10
+	struct NaturalFileOrder
+	{
+		int compareElements(const File& a, const File& b) const
+		{
+			return a.getFileName().compareNatural(b.getFileName());
+		}
+	} order;
+	result.sort(order);
+	return result;
+}
+
+void Image2MIDIBatchConverter::commitReadyFrames()
+{
+	m_commit_posted = false;
+	if (m_next_commit < (int)m_slots.size() && m_slots[m_next_commit]->m_ready == true)
+	{
+		if (ValidatePtr(m_track, "MediaTrack*") == false)
+		{
+			ShowConsoleMsg("Image2MIDI batch : target track was removed, conversion cancelled\n");
+			m_tasks.cancel();
+			m_tasks.wait();
+			m_next_commit = (int)m_slots.size();
+		}
+		else
+		{
+			PreventUIRefresh(1);
+			// keep the message thread responsive when many frames became ready at once
+			double budgetend = Time::getMillisecondCounterHiRes() + 30.0;
+			while (m_next_commit < (int)m_slots.size() && m_slots[m_next_commit]->m_ready == true
+				&& Time::getMillisecondCounterHiRes() < budgetend)
+			{
+				commitFrame(m_next_commit);
+				++m_next_commit;
+			}
+			PreventUIRefresh(-1);
+			UpdateArrange();
+			// the budget ran out, the rest goes in the next drain
+			if (m_next_commit < (int)m_slots.size() && m_slots[m_next_commit]->m_ready == true)
+				postCommit();
+		}
+		if (isFinished())
+		{
+			Undo_OnStateChange("Image2MIDI : batch convert");
+			double elapsed = (Time::getMillisecondCounterHiRes() - m_start_time) / 1000.0;
+			char buf[256];
+			sprintf(buf, "Image2MIDI batch : %d frames, %d notes in %.2f seconds (%.1f frames/s, %d threads)\n",
+				(int)m_slots.size(), m_notes_written, elapsed, m_slots.size() / jmax(0.001, elapsed), m_tasks.getPool().getNumThreads());
+			ShowConsoleMsg(buf);
+			if (OnFinished)
+				OnFinished();
+		}
+	}
+}
+
+void Image2MIDIBatchConverter::commitFrame(int index)
+{
+	auto& slot = *m_slots[index];
+	double startqn = m_start_qn + index * m_frame_qn;
+	bool inqn = true;
+	MediaItem* item = CreateNewMIDIItemInProj(m_track, startqn, startqn + m_frame_qn, &inqn);
+	MediaItem_Take* take = GetActiveTake(item);
+	if (take != nullptr && slot.m_grid != nullptr)
+	{
+		Image2MIDIParams params = m_params;
+		params.m_length_ppq = MIDI_GetPPQPosFromProjQN(take, startqn + m_frame_qn) - MIDI_GetPPQPosFromProjQN(take, startqn);
+		auto events = mapCellsToEvents(*slot.m_grid, params);
+		MIDIBulkWriter writer;
+		for (auto& note : events.m_notes)
+			writer.addNote(note.m_start_ppq, note.m_end_ppq, params.m_midi_channel, note.m_pitch, note.m_velocity);
+		for (auto& cc : events.m_ccs)
+			writer.addCC(cc.m_ppq, 0xb0, params.m_midi_channel, cc.m_cc, cc.m_value);
+		writer.replaceTakeEvents(take);
+		GetSetMediaItemTakeInfo_String(take, "P_NAME", (char*)slot.m_file.getFileName().toRawUTF8(), true);
+		m_notes_written += writer.getNumNotes();
+	}
+	// the analysis is no longer needed once the frame is in the project
+	slot.m_grid = nullptr;
+}
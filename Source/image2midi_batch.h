@@ -0,0 +1,51 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "image2midi_analysis.h"
+#include "image2midi_cache.h"
+#include "task_pool.h"
+#include "main_thread_tasks.h"
+
+class MediaTrack;
+
+// Converts a sequence of image files into consecutive MIDI items on a track. The frames are
+// decoded and analysed on the shared task pool, and each finished frame posts a commit to the main
+// thread. The items are created strictly in frame order, so the result does not depend on which
+// frame finishes first.
+class Image2MIDIBatchConverter
+{
+public:
+	Image2MIDIBatchConverter(Array<File> frames, MediaTrack* track, double startqn, double frameqn, Image2MIDIParams params,
+		std::shared_ptr<Image2MIDIAnalysisCache> cache);
+	~Image2MIDIBatchConverter();
+	void start();
+	bool isFinished() const { return m_next_commit >= (int)m_slots.size(); }
+	int getNumFrames() const { return (int)m_slots.size(); }
+	int getNumCommitted() const { return m_next_commit; }
+	std::function<void(void)> OnFinished;
+	static Array<File> findFrameFiles(const File& folder);
+private:
+	struct FrameSlot
+	{
+		File m_file;
+		std::shared_ptr<Image2MIDICellGrid> m_grid;
+		std::atomic<bool> m_ready{ false };
+	};
+	void postCommit();
+	void commitReadyFrames();
+	void commitFrame(int index);
+	std::shared_ptr<Image2MIDIAnalysisCache> m_cache;
+	std::vector<std::unique_ptr<FrameSlot>> m_slots;
+	MediaTrack* m_track = nullptr;
+	double m_start_qn = 0.0;
+	double m_frame_qn = 4.0;
+	Image2MIDIParams m_params;
+	int m_next_commit = 0;
+	int m_notes_written = 0;
+	double m_start_time = 0.0;
+	// at most one commit is queued at a time, however many frames finish meanwhile
+	std::atomic<bool> m_commit_posted{ false };
+	MainThreadTaskToken m_main_thread;
+	// last, so it is destroyed and its tasks are finished before the slots go away
+	TaskGroup m_tasks;
+};
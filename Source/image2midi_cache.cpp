@@ -0,0 +1,259 @@
+#include "image2midi_cache.h"
+#include "image2midi_loader.h"
+
+namespace
+{
+	const int cachefilemagic = 0x43324d49; // "IM2C"
+	const int cachefileversion = 1;
+	const size_t maxhashmemoentries = 16384;
+
+	int64 getGridBytes(const Image2MIDICellGrid& grid)
+	{
+		return sizeof(Image2MIDICellGrid) + (int64)grid.m_cols * grid.m_rows * 3 * sizeof(float);
+	}
+}
+
+Image2MIDIAnalysisCache::Image2MIDIAnalysisCache(File diskfolder, int64 maxmemorybytes, int64 maxdiskbytes) :
+	m_disk_folder(diskfolder), m_max_memory(maxmemorybytes), m_max_disk(maxdiskbytes)
+{
+	if (m_disk_folder != File())
+	{
+		m_disk_folder.createDirectory();
+		scanDisk();
+	}
+}
+
+std::shared_ptr<Image2MIDICellGrid> Image2MIDIAnalysisCache::getOrLoad(const File& imgfile, int gridsize)
+{
+	String hash = getContentHash(imgfile);
+	if (hash.isEmpty())
+		return std::make_shared<Image2MIDICellGrid>();
+	String key = hash + "_" + String(gridsize);
+	auto grid = findInMemory(key);
+	if (grid != nullptr)
+	{
+		++m_memory_hits;
+		return grid;
+	}
+	grid = readFromDisk(key);
+	if (grid != nullptr)
+	{
+		++m_disk_hits;
+		storeInMemory(key, grid);
+		return grid;
+	}
+	++m_misses;
+	grid = loadImage2MIDICellGrid(imgfile, gridsize);
+	// failed loads are not cached, the file may be fixed on disk later
+	if (grid->m_cols > 0 && grid->m_rows > 0)
+	{
+		storeInMemory(key, grid);
+		writeToDisk(key, *grid);
+	}
+	return grid;
+}
+
+void Image2MIDIAnalysisCache::clearMemory()
+{
+	const ScopedLock locker(m_cs);
+	m_lru.clear();
+	m_lru_index.clear();
+	m_memory_used = 0;
+}
+
+String Image2MIDIAnalysisCache::getContentHash(const File& imgfile)
+{
+	String path = imgfile.getFullPathName();
+	int64 size = imgfile.getSize();
+	Time modified = imgfile.getLastModificationTime();
+	{
+		const ScopedLock locker(m_cs);
+		auto it = m_hash_memo.find(path);
+		if (it != m_hash_memo.end() && it->second.m_size == size && it->second.m_modified == modified)
+		{
+			m_hash_memo_order.splice(m_hash_memo_order.begin(), m_hash_memo_order, it->second.m_order);
+			return it->second.m_hash;
+		}
+	}
+	if (imgfile.existsAsFile() == false)
+		return String();
+	// hashing happens outside the lock, it reads the whole file
+	String hash = MD5(imgfile).toHexString();
+	const ScopedLock locker(m_cs);
+	auto it = m_hash_memo.find(path);
+	if (it != m_hash_memo.end())
+		m_hash_memo_order.erase(it->second.m_order);
+	m_hash_memo_order.push_front(path);
+	m_hash_memo[path] = { size, modified, hash, m_hash_memo_order.begin() };
+	while (m_hash_memo.size() > maxhashmemoentries)
+	{
+		m_hash_memo.erase(m_hash_memo_order.back());
+		m_hash_memo_order.pop_back();
+	}
+	return hash;
+}
+
+std::shared_ptr<Image2MIDICellGrid> Image2MIDIAnalysisCache::findInMemory(const String& key)
+{
+	const ScopedLock locker(m_cs);
+	auto it = m_lru_index.find(key);
+	if (it == m_lru_index.end())
+		return nullptr;
+	m_lru.splice(m_lru.begin(), m_lru, it->second);
+	return it->second->m_grid;
+}
+
+void Image2MIDIAnalysisCache::storeInMemory(const String& key, std::shared_ptr<Image2MIDICellGrid> grid)
+{
+	const ScopedLock locker(m_cs);
+	if (m_lru_index.count(key) > 0)
+		return;
+	MemoryEntry entry;
+	entry.m_key = key;
+	entry.m_grid = grid;
+	entry.m_bytes = getGridBytes(*grid);
+	m_lru.push_front(entry);
+	m_lru_index[key] = m_lru.begin();
+	m_memory_used += entry.m_bytes;
+	// the newest entry is always kept, even if it alone exceeds the limit
+	while (m_memory_used > m_max_memory && m_lru.size() > 1)
+	{
+		m_memory_used -= m_lru.back().m_bytes;
+		m_lru_index.erase(m_lru.back().m_key);
+		m_lru.pop_back();
+	}
+}
+
+std::shared_ptr<Image2MIDICellGrid> Image2MIDIAnalysisCache::readFromDisk(const String& key)
+{
+	if (m_disk_folder == File())
+		return nullptr;
+	File f = m_disk_folder.getChildFile(key + ".i2m");
+	FileInputStream in(f);
+	if (in.openedOk() == false)
+	{
+		// removed behind our back
+		removeFromDisk(key);
+		return nullptr;
+	}
+	if (in.readInt() != cachefilemagic || in.readInt() != cachefileversion)
+		return nullptr;
+	auto grid = std::make_shared<Image2MIDICellGrid>();
+	grid->m_image_w = in.readInt();
+	grid->m_image_h = in.readInt();
+	grid->m_gridsize = in.readInt();
+	int cols = in.readInt();
+	int rows = in.readInt();
+	if (cols < 0 || rows < 0 || (int64)cols * rows * 3 * sizeof(float) != in.getNumBytesRemaining())
+		return nullptr;
+	grid->resize(cols, rows);
+	const int planebytes = cols * rows * (int)sizeof(float);
+	if (in.read(grid->m_red.data(), planebytes) != planebytes ||
+		in.read(grid->m_green.data(), planebytes) != planebytes ||
+		in.read(grid->m_blue.data(), planebytes) != planebytes)
+		return nullptr;
+	// the modification time doubles as the last access time for the disk LRU
+	f.setLastModificationTime(Time::getCurrentTime());
+	touchOnDisk(key);
+	return grid;
+}
+
+void Image2MIDIAnalysisCache::writeToDisk(const String& key, const Image2MIDICellGrid& grid)
+{
+	if (m_disk_folder == File())
+		return;
+	File f = m_disk_folder.getChildFile(key + ".i2m");
+	TemporaryFile temp(f);
+	{
+		FileOutputStream out(temp.getFile());
+		if (out.openedOk() == false)
+			return;
+		out.writeInt(cachefilemagic);
+		out.writeInt(cachefileversion);
+		out.writeInt(grid.m_image_w);
+		out.writeInt(grid.m_image_h);
+		out.writeInt(grid.m_gridsize);
+		out.writeInt(grid.m_cols);
+		out.writeInt(grid.m_rows);
+		const size_t planebytes = grid.m_red.size() * sizeof(float);
+		out.write(grid.m_red.data(), planebytes);
+		out.write(grid.m_green.data(), planebytes);
+		out.write(grid.m_blue.data(), planebytes);
+		out.flush();
+		if (out.getStatus().failed())
+			return;
+	}
+	// another thread may have written the same key meanwhile, either copy is fine
+	if (temp.overwriteTargetFileWithTemporary() == true)
+		addToDisk(key, f.getSize());
+}
+
+void Image2MIDIAnalysisCache::scanDisk()
+{
+	// only the constructor lists and stats the folder, after that the index is kept up to date
+	std::vector<std::pair<Time, File>> files;
+	for (auto& f : m_disk_folder.findChildFiles(File::findFiles, false, "*.i2m"))
+		files.push_back({ f.getLastModificationTime(), f });
+	std::sort(files.begin(), files.end(), [](const std::pair<Time, File>& a, const std::pair<Time, File>& b)
+	{
+		return a.first > b.first;
+	});
+	const ScopedLock locker(m_cs);
+	for (auto& e : files)
+	{
+		String key = e.second.getFileNameWithoutExtension();
+		int64 bytes = e.second.getSize();
+		m_disk_lru.push_back(key);
+		m_disk_index[key] = { std::prev(m_disk_lru.end()), bytes };
+		m_disk_used += bytes;
+	}
+}
+
+void Image2MIDIAnalysisCache::touchOnDisk(const String& key)
+{
+	const ScopedLock locker(m_cs);
+	auto it = m_disk_index.find(key);
+	if (it != m_disk_index.end())
+		m_disk_lru.splice(m_disk_lru.begin(), m_disk_lru, it->second.first);
+}
+
+void Image2MIDIAnalysisCache::addToDisk(const String& key, int64 bytes)
+{
+	Array<File> todelete;
+	{
+		const ScopedLock locker(m_cs);
+		auto it = m_disk_index.find(key);
+		if (it != m_disk_index.end())
+		{
+			m_disk_used -= it->second.second;
+			m_disk_lru.erase(it->second.first);
+			m_disk_index.erase(it);
+		}
+		m_disk_lru.push_front(key);
+		m_disk_index[key] = { m_disk_lru.begin(), bytes };
+		m_disk_used += bytes;
+		// the newest file is always kept, even if it alone exceeds the limit
+		while (m_disk_used > m_max_disk && m_disk_lru.size() > 1)
+		{
+			auto last = m_disk_index.find(m_disk_lru.back());
+			m_disk_used -= last->second.second;
+			todelete.add(m_disk_folder.getChildFile(last->first + ".i2m"));
+			m_disk_index.erase(last);
+			m_disk_lru.pop_back();
+		}
+	}
+	// deleting can be slow, the other threads should not wait for it
+	for (auto& f : todelete)
+		f.deleteFile();
+}
+
+void Image2MIDIAnalysisCache::removeFromDisk(const String& key)
+{
+	const ScopedLock locker(m_cs);
+	auto it = m_disk_index.find(key);
+	if (it == m_disk_index.end())
+		return;
+	m_disk_used -= it->second.second;
+	m_disk_lru.erase(it->second.first);
+	m_disk_index.erase(it);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "image2midi_analysis.h"
+#include <list>
+#include <map>
+
+// Keeps analysed cell grids in memory and on disk, keyed by the MD5 of the image file content
+// and the grid size, so a file that was analysed once is never decoded again, even after a
+// rename or in a later session. Both stores are bounded and evict the least recently used
+// entries. Safe to use from several threads at once.
+class Image2MIDIAnalysisCache
+{
+public:
+	Image2MIDIAnalysisCache(File diskfolder, int64 maxmemorybytes = 64 * 1024 * 1024, int64 maxdiskbytes = 512 * 1024 * 1024);
+	// Returns the cached grid, or decodes and analyses the file and stores the result
+	std::shared_ptr<Image2MIDICellGrid> getOrLoad(const File& imgfile, int gridsize);
+	void clearMemory();
+	int64 getMemoryHits() const { return m_memory_hits; }
+	int64 getDiskHits() const { return m_disk_hits; }
+	int64 getMisses() const { return m_misses; }
+private:
+	struct MemoryEntry
+	{
+		String m_key;
+		std::shared_ptr<Image2MIDICellGrid> m_grid;
+		int64 m_bytes = 0;
+	};
+	struct HashMemo
+	{
+		int64 m_size = 0;
+		Time m_modified;
+		String m_hash;
+		std::list<String>::iterator m_order;
+	};
+	String getContentHash(const File& imgfile);
+	std::shared_ptr<Image2MIDICellGrid> findInMemory(const String& key);
+	void storeInMemory(const String& key, std::shared_ptr<Image2MIDICellGrid> grid);
+	std::shared_ptr<Image2MIDICellGrid> readFromDisk(const String& key);
+	void writeToDisk(const String& key, const Image2MIDICellGrid& grid);
+	void scanDisk();
+	void touchOnDisk(const String& key);
+	void addToDisk(const String& key, int64 bytes);
+	void removeFromDisk(const String& key);
+	CriticalSection m_cs;
+	File m_disk_folder;
+	int64 m_max_memory = 0;
+	int64 m_max_disk = 0;
+	int64 m_memory_used = 0;
+	// most recently used at the front
+	std::list<MemoryEntry> m_lru;
+	std::map<String, std::list<MemoryEntry>::iterator> m_lru_index;
+	// avoids rehashing files whose size and modification time have not changed. Bounded like
+	// the other stores, the least recently used paths are at the back of m_hash_memo_order.
+	std::map<String, HashMemo> m_hash_memo;
+	std::list<String> m_hash_memo_order;
+	// the files in the disk folder, scanned once, most recently used at the front
+	std::list<String> m_disk_lru;
+	std::map<String, std::pair<std::list<String>::iterator, int64>> m_disk_index;
+	int64 m_disk_used = 0;
+	std::atomic<int64> m_memory_hits{ 0 };
+	std::atomic<int64> m_disk_hits{ 0 };
+	std::atomic<int64> m_misses{ 0 };
+};
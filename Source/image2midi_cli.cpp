@@ -0,0 +1,235 @@
+// Headless Image2MIDI converter, built by image2midi_cli.jucer. Writes one Standard MIDI File
+// per input image using the same engine as the Image2MIDI window in the REAPER extension.
+
+#include "JuceHeader.h"
+#include "image2midi_engine.h"
+#include "task_pool.h"
+#include <iostream>
+#include <set>
+
+namespace
+{
+	void printUsage()
+	{
+		std::cout << "Usage: image2midi_cli [options] <image or folder>...\n"
+			<< "  -o <folder>          output folder (default: next to each image)\n"
+			<< "  --grid <pixels>      grid cell size (default 16)\n"
+			<< "  --threshold <0..1>   brightness threshold (default 0.5)\n"
+			<< "  --pitch <low> <high> pitch range (default 0 127)\n"
+			<< "  --velocity <source>  velocity source (default Constant)\n"
+			<< "  --length <source>    note length source (default Constant)\n"
+			<< "  --cc <num>:<source>  add a CC lane, can be repeated\n"
+			<< "  --ppq <ticks>        ticks per quarter note (default 960)\n"
+			<< "  --span <ticks>       ticks the image width is spread over (default 4000)\n"
+			<< "  --jobs <count>       worker threads (default: number of CPUs)\n"
+			<< "  --cache <folder>     keep analysis results in this folder\n"
+			<< "  --bench <runs>       time analysis and mapping without writing files\n"
+			<< "Sources: Constant Brightness Red Green Blue Hue Saturation\n";
+	}
+
+	bool parseSource(const String& name, Image2MIDISource& result)
+	{
+		for (int i = 0; i < (int)Image2MIDISource::NumSources; ++i)
+		{
+			if (name.equalsIgnoreCase(getImage2MIDISourceName((Image2MIDISource)i)))
+			{
+				result = (Image2MIDISource)i;
+				return true;
+			}
+		}
+		std::cerr << "Unknown source : " << name << "\n";
+		return false;
+	}
+
+	struct ConvertJob
+	{
+		ConvertJob(File infile, File outfile, const Image2MIDIParams& params, int ppq, Image2MIDIAnalysisCache* cache) :
+			m_infile(infile), m_outfile(outfile), m_params(params), m_ppq(ppq), m_cache(cache) {}
+		void run()
+		{
+			Image2MIDIEvents events;
+			m_ok = convertImageFileToMIDIEvents(m_infile, m_params, events, m_cache) &&
+				writeImage2MIDIEventsToMidiFile(events, m_params, m_outfile, m_ppq);
+			m_numnotes = (int)events.m_notes.size();
+		}
+		File m_infile;
+		File m_outfile;
+		bool m_ok = false;
+		int m_numnotes = 0;
+	private:
+		Image2MIDIParams m_params;
+		int m_ppq = 960;
+		Image2MIDIAnalysisCache* m_cache = nullptr;
+	};
+
+	void runBenchmark(const Array<File>& inputs, const Image2MIDIParams& params, int runs)
+	{
+		double loadms = 0.0;
+		double mapms = 0.0;
+		int64 numnotes = 0;
+		for (int run = 0; run < runs; ++run)
+		{
+			for (auto& f : inputs)
+			{
+				double t0 = Time::getMillisecondCounterHiRes();
+				auto grid = loadImage2MIDICellGrid(f, params.m_gridsize);
+				double t1 = Time::getMillisecondCounterHiRes();
+				auto events = mapCellsToEvents(*grid, params);
+				double t2 = Time::getMillisecondCounterHiRes();
+				loadms += t1 - t0;
+				mapms += t2 - t1;
+				numnotes += events.m_notes.size();
+			}
+		}
+		double n = (double)runs * inputs.size();
+		std::cout << "images : " << inputs.size() << " x " << runs << " runs\n"
+			<< "decode+analyse : " << loadms / n << " ms per image\n"
+			<< "map : " << mapms / n << " ms per image\n"
+			<< "notes : " << numnotes / n << " per image\n";
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Image2MIDIParams params;
+	File outfolder;
+	File cachefolder;
+	int ppq = 960;
+	int jobs = SystemStats::getNumCpus();
+	int benchruns = 0;
+	Array<File> inputs;
+	StringArray args;
+	for (int i = 1; i < argc; ++i)
+		args.add(CharPointer_UTF8(argv[i]));
+	for (int i = 0; i < args.size(); ++i)
+	{
+		const String& arg = args[i];
+		// all options take at least one value
+		bool hasvalue = i + 1 < args.size();
+		if (arg == "-h" || arg == "--help")
+		{
+			printUsage();
+			return 0;
+		}
+		else if (arg == "-o" && hasvalue)
+			outfolder = File::getCurrentWorkingDirectory().getChildFile(args[++i]);
+		else if (arg == "--grid" && hasvalue)
+			params.m_gridsize = jmax(1, args[++i].getIntValue());
+		else if (arg == "--threshold" && hasvalue)
+			params.m_brightness_th = args[++i].getFloatValue();
+		else if (arg == "--pitch" && i + 2 < args.size())
+		{
+			params.m_pitch_low = jlimit(0, 127, args[++i].getIntValue());
+			params.m_pitch_high = jlimit(params.m_pitch_low, 127, args[++i].getIntValue());
+		}
+		else if (arg == "--velocity" && hasvalue)
+		{
+			if (parseSource(args[++i], params.m_velocity.m_source) == false)
+				return 1;
+		}
+		else if (arg == "--length" && hasvalue)
+		{
+			if (parseSource(args[++i], params.m_note_length.m_source) == false)
+				return 1;
+		}
+		else if (arg == "--cc" && hasvalue)
+		{
+			String spec = args[++i];
+			Image2MIDICCLane lane;
+			lane.m_cc = jlimit(0, 127, spec.upToFirstOccurrenceOf(":", false, false).getIntValue());
+			if (parseSource(spec.fromFirstOccurrenceOf(":", false, false), lane.m_mapping.m_source) == false)
+				return 1;
+			if (params.m_cc_lanes.size() < Image2MIDIMaxCCLanes)
+				params.m_cc_lanes.push_back(lane);
+		}
+		else if (arg == "--ppq" && hasvalue)
+			ppq = jlimit(24, 32767, args[++i].getIntValue());
+		else if (arg == "--span" && hasvalue)
+			params.m_length_ppq = jmax(1.0, args[++i].getDoubleValue());
+		else if (arg == "--jobs" && hasvalue)
+			jobs = jmax(1, args[++i].getIntValue());
+		else if (arg == "--cache" && hasvalue)
+			cachefolder = File::getCurrentWorkingDirectory().getChildFile(args[++i]);
+		else if (arg == "--bench" && hasvalue)
+			benchruns = jmax(1, args[++i].getIntValue());
+		else if (arg.startsWith("-"))
+		{
+			std::cerr << "Unknown option : " << arg << "\n";
+			printUsage();
+			return 1;
+		}
+		else
+		{
+			File f = File::getCurrentWorkingDirectory().getChildFile(arg);
+			if (f.isDirectory())
+			{
+				Array<File> children = f.findChildFiles(File::findFiles, false, "*.png;*.jpg;*.jpeg");
+				struct NaturalFileOrder
+				{
+					int compareElements(const File& a, const File& b) const
+					{
+						return a.getFileName().compareNatural(b.getFileName());
+					}
+				} order;
+				children.sort(order);
+				inputs.addArray(children);
+			}
+			else inputs.add(f);
+		}
+	}
+	if (inputs.size() == 0)
+	{
+		printUsage();
+		return 1;
+	}
+	if (benchruns > 0)
+	{
+		runBenchmark(inputs, params, benchruns);
+		return 0;
+	}
+	std::unique_ptr<Image2MIDIAnalysisCache> cache;
+	if (cachefolder != File())
+		cache = std::make_unique<Image2MIDIAnalysisCache>(cachefolder);
+	if (outfolder != File())
+		outfolder.createDirectory();
+	double t0 = Time::getMillisecondCounterHiRes();
+	std::vector<std::unique_ptr<ConvertJob>> convertjobs;
+	{
+		TaskPool pool(jobs);
+		TaskGroup group(pool, "image2midi", TaskPriority::Batch);
+		// a.png and a.jpg would both write a.mid, from two tasks at once
+		// compared lowercase, the file systems of Windows and macOS ignore the case
+		std::set<String> usedoutnames;
+		for (auto& f : inputs)
+		{
+			File outdir = outfolder != File() ? outfolder : f.getParentDirectory();
+			File outfile = outdir.getChildFile(f.getFileNameWithoutExtension() + ".mid");
+			if (usedoutnames.count(outfile.getFullPathName().toLowerCase()) > 0)
+			{
+				String base = f.getFileNameWithoutExtension() + "_" + f.getFileExtension().substring(1);
+				outfile = outdir.getChildFile(base + ".mid");
+				for (int i = 2; usedoutnames.count(outfile.getFullPathName().toLowerCase()) > 0; ++i)
+					outfile = outdir.getChildFile(base + "_" + String(i) + ".mid");
+				std::cerr << "Output name already used, writing " << f.getFullPathName() << " to " << outfile.getFileName() << "\n";
+			}
+			usedoutnames.insert(outfile.getFullPathName().toLowerCase());
+			convertjobs.push_back(std::make_unique<ConvertJob>(f, outfile, params, ppq, cache.get()));
+			ConvertJob* job = convertjobs.back().get();
+			group.add([job]() { job->run(); });
+		}
+		group.wait();
+	}
+	double elapsed = (Time::getMillisecondCounterHiRes() - t0) / 1000.0;
+	int failures = 0;
+	for (auto& job : convertjobs)
+	{
+		if (job->m_ok == false)
+		{
+			std::cerr << "Failed : " << job->m_infile.getFullPathName() << "\n";
+			++failures;
+		}
+	}
+	std::cout << inputs.size() - failures << " of " << inputs.size() << " images converted in "
+		<< elapsed << " seconds (" << inputs.size() / jmax(0.001, elapsed) << " images/s, " << jobs << " threads)\n";
+	return failures > 0 ? 1 : 0;
+}
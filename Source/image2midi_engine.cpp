@@ -0,0 +1,36 @@
+#include "image2midi_engine.h"
+
+bool convertImageFileToMIDIEvents(const File& imgfile, const Image2MIDIParams& params, Image2MIDIEvents& result, Image2MIDIAnalysisCache* cache)
+{
+	std::shared_ptr<Image2MIDICellGrid> grid;
+	if (cache != nullptr)
+		grid = cache->getOrLoad(imgfile, params.m_gridsize);
+	else grid = loadImage2MIDICellGrid(imgfile, params.m_gridsize);
+	result = mapCellsToEvents(*grid, params);
+	return grid->m_cols > 0 && grid->m_rows > 0;
+}
+
+bool writeImage2MIDIEventsToMidiFile(const Image2MIDIEvents& events, const Image2MIDIParams& params, const File& outfile, int ticksperquarternote)
+{
+	// JUCE counts MIDI channels from 1
+	const int chan = jlimit(0, 15, params.m_midi_channel) + 1;
+	MidiMessageSequence seq;
+	for (auto& note : events.m_notes)
+	{
+		seq.addEvent(MidiMessage::noteOn(chan, note.m_pitch, (uint8)note.m_velocity), note.m_start_ppq);
+		seq.addEvent(MidiMessage::noteOff(chan, note.m_pitch), note.m_end_ppq);
+	}
+	for (auto& cc : events.m_ccs)
+		seq.addEvent(MidiMessage::controllerEvent(chan, cc.m_cc, cc.m_value), cc.m_ppq);
+	seq.updateMatchedPairs();
+	MidiFile midifile;
+	midifile.setTicksPerQuarterNote(ticksperquarternote);
+	midifile.addTrack(seq);
+	TemporaryFile temp(outfile);
+	{
+		FileOutputStream out(temp.getFile());
+		if (out.openedOk() == false || midifile.writeTo(out) == false)
+			return false;
+	}
+	return temp.overwriteTargetFileWithTemporary();
+}
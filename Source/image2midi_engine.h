@@ -0,0 +1,17 @@
+#pragma once
+
+// Entry point to the Image2MIDI conversion engine. Everything included from here only depends
+// on juce_core, juce_graphics, juce_cryptography and juce_audio_basics, so the same sources
+// build into the REAPER extension and into the headless command line converter.
+
+#include "JuceHeader.h"
+#include "image2midi_analysis.h"
+#include "image2midi_loader.h"
+#include "image2midi_cache.h"
+
+// Loads (or fetches from the cache, if one is given) the analysis of an image file and maps it to events.
+// Returns false if the file could not be decoded or is smaller than one grid cell.
+bool convertImageFileToMIDIEvents(const File& imgfile, const Image2MIDIParams& params, Image2MIDIEvents& result, Image2MIDIAnalysisCache* cache = nullptr);
+
+// Writes the events as a single track Standard MIDI File. Event positions are taken as ticks at the given resolution.
+bool writeImage2MIDIEventsToMidiFile(const Image2MIDIEvents& events, const Image2MIDIParams& params, const File& outfile, int ticksperquarternote = 960);
@@ -0,0 +1,434 @@
+#include "image2midi_loader.h"
+
+namespace
+{
+	// Folds 8 bit RGB scanlines into per cell colour sums and writes the averaged
+	// cells into the grid whenever a row of cells is complete
+	class CellRowAccumulator
+	{
+	public:
+		CellRowAccumulator(Image2MIDICellGrid& grid) : m_grid(grid), m_sums(grid.m_cols * 3, 0) {}
+		// rgb must hold at least m_cols * m_gridsize pixels
+		void addScanline(const uint8* rgb, int y)
+		{
+			const int gs = m_grid.m_gridsize;
+			uint64* sums = m_sums.data();
+			for (int cx = 0; cx < m_grid.m_cols; ++cx)
+			{
+				uint32 r = 0, g = 0, b = 0;
+				const uint8* pix = rgb + cx * gs * 3;
+				for (int i = 0; i < gs; ++i)
+				{
+					r += pix[0];
+					g += pix[1];
+					b += pix[2];
+					pix += 3;
+				}
+				sums[cx * 3 + 0] += r;
+				sums[cx * 3 + 1] += g;
+				sums[cx * 3 + 2] += b;
+			}
+			if (y % gs == gs - 1)
+				emitCellRow(y / gs);
+		}
+	private:
+		void emitCellRow(int cy)
+		{
+			const double scaler = 1.0 / (255.0 * m_grid.m_gridsize * m_grid.m_gridsize);
+			for (int cx = 0; cx < m_grid.m_cols; ++cx)
+			{
+				int i = cx * m_grid.m_rows + cy;
+				m_grid.m_red[i] = (float)(m_sums[cx * 3 + 0] * scaler);
+				m_grid.m_green[i] = (float)(m_sums[cx * 3 + 1] * scaler);
+				m_grid.m_blue[i] = (float)(m_sums[cx * 3 + 2] * scaler);
+			}
+			std::fill(m_sums.begin(), m_sums.end(), 0);
+		}
+		Image2MIDICellGrid& m_grid;
+		std::vector<uint64> m_sums;
+	};
+
+	std::shared_ptr<Image2MIDICellGrid> makeEmptyGrid(int w, int h, int gridsize)
+	{
+		auto grid = std::make_shared<Image2MIDICellGrid>();
+		if (w < 1 || h < 1 || gridsize < 1)
+			return grid;
+		grid->m_image_w = w;
+		grid->m_image_h = h;
+		grid->m_gridsize = gridsize;
+		grid->resize(w / gridsize, h / gridsize);
+		return grid;
+	}
+
+	const uint8 pngsignature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+
+	bool isChunkType(const char* type, const char* expected)
+	{
+		return memcmp(type, expected, 4) == 0;
+	}
+
+	// Presents the payloads of consecutive IDAT chunks as one continuous stream, reading
+	// the chunk headers from the file as it goes
+	class PNGIdatInputStream : public InputStream
+	{
+	public:
+		PNGIdatInputStream(InputStream& source, uint32 firstchunklen) :
+			m_source(source), m_chunk_remaining(firstchunklen) {}
+		int64 getTotalLength() override { return -1; }
+		bool isExhausted() override { return m_finished; }
+		int64 getPosition() override { return m_position; }
+		bool setPosition(int64 newpos) override { return newpos == m_position; }
+		int read(void* dest, int numbytes) override
+		{
+			int done = 0;
+			while (done < numbytes && m_finished == false)
+			{
+				if (m_chunk_remaining == 0)
+				{
+					m_source.skipNextBytes(4); // crc
+					uint32 len = (uint32)m_source.readIntBigEndian();
+					char type[4];
+					if (m_source.read(type, 4) != 4 || isChunkType(type, "IDAT") == false)
+					{
+						m_finished = true;
+						break;
+					}
+					m_chunk_remaining = len;
+					continue;
+				}
+				int toread = (int)jmin<int64>(m_chunk_remaining, numbytes - done);
+				int got = m_source.read((char*)dest + done, toread);
+				if (got <= 0)
+				{
+					m_finished = true;
+					break;
+				}
+				done += got;
+				m_chunk_remaining -= got;
+			}
+			m_position += done;
+			return done;
+		}
+	private:
+		InputStream& m_source;
+		uint32 m_chunk_remaining = 0;
+		int64 m_position = 0;
+		bool m_finished = false;
+	};
+
+	bool readFully(InputStream& in, uint8* dest, int numbytes)
+	{
+		int done = 0;
+		while (done < numbytes)
+		{
+			int got = in.read(dest + done, numbytes - done);
+			if (got <= 0)
+				return false;
+			done += got;
+		}
+		return true;
+	}
+
+	uint8 paethPredictor(int a, int b, int c)
+	{
+		int p = a + b - c;
+		int pa = std::abs(p - a);
+		int pb = std::abs(p - b);
+		int pc = std::abs(p - c);
+		if (pa <= pb && pa <= pc)
+			return (uint8)a;
+		if (pb <= pc)
+			return (uint8)b;
+		return (uint8)c;
+	}
+
+	bool unfilterScanline(int filtertype, uint8* cur, const uint8* prev, int rowbytes, int bpp)
+	{
+		switch (filtertype)
+		{
+		case 0:
+			return true;
+		case 1:
+			for (int i = bpp; i < rowbytes; ++i)
+				cur[i] += cur[i - bpp];
+			return true;
+		case 2:
+			for (int i = 0; i < rowbytes; ++i)
+				cur[i] += prev[i];
+			return true;
+		case 3:
+			for (int i = 0; i < rowbytes; ++i)
+			{
+				int left = i >= bpp ? cur[i - bpp] : 0;
+				cur[i] += (uint8)((left + prev[i]) / 2);
+			}
+			return true;
+		case 4:
+			for (int i = 0; i < rowbytes; ++i)
+			{
+				int left = i >= bpp ? cur[i - bpp] : 0;
+				int upleft = i >= bpp ? prev[i - bpp] : 0;
+				cur[i] += paethPredictor(left, prev[i], upleft);
+			}
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	struct PNGHeader
+	{
+		int m_width = 0;
+		int m_height = 0;
+		int m_bitdepth = 0;
+		int m_colortype = 0;
+		int m_interlace = 0;
+		int getChannels() const
+		{
+			switch (m_colortype)
+			{
+			case 0: return 1;
+			case 2: return 3;
+			case 3: return 1;
+			case 4: return 2;
+			case 6: return 4;
+			}
+			return 0;
+		}
+		// the colour type and bit depth pairs the PNG specification allows
+		bool isValid() const
+		{
+			switch (m_colortype)
+			{
+			case 0: return m_bitdepth == 1 || m_bitdepth == 2 || m_bitdepth == 4 || m_bitdepth == 8 || m_bitdepth == 16;
+			case 3: return m_bitdepth == 1 || m_bitdepth == 2 || m_bitdepth == 4 || m_bitdepth == 8;
+			case 2:
+			case 4:
+			case 6: return m_bitdepth == 8 || m_bitdepth == 16;
+			}
+			return false;
+		}
+	};
+
+	// Same as the premultiplied pixels JUCE decodes into, so both decoders see the same brightness
+	inline uint8 applyAlpha(int v, int alpha)
+	{
+		return (uint8)((v * alpha + 127) / 255);
+	}
+
+	// Converts one unfiltered scanline into 8 bit RGB premultiplied by the alpha channel or the tRNS chunk
+	void scanlineToRGB(const PNGHeader& hdr, const uint8* row, const std::vector<uint8>& palette, const std::vector<uint8>& trns,
+		uint8* rgb, int numpixels)
+	{
+		const int channels = hdr.getChannels();
+		const int depth = hdr.m_bitdepth;
+		// the tRNS sample values of greyscale and RGB images are 16 bit, at the image's bit depth
+		auto trnsSample = [&trns](int index) { return (size_t)(index * 2 + 1) < trns.size() ? (trns[index * 2] << 8) | trns[index * 2 + 1] : -1; };
+		auto setPalette = [&](int x, int v)
+		{
+			int alpha = (size_t)v < trns.size() ? trns[v] : 255;
+			for (int c = 0; c < 3; ++c)
+				rgb[x * 3 + c] = applyAlpha((size_t)(v * 3 + c) < palette.size() ? palette[v * 3 + c] : 0, alpha);
+		};
+		if (depth < 8)
+		{
+			const int maxval = (1 << depth) - 1;
+			for (int x = 0; x < numpixels; ++x)
+			{
+				int bitpos = x * depth;
+				int v = (row[bitpos / 8] >> (8 - depth - bitpos % 8)) & maxval;
+				if (hdr.m_colortype == 3)
+				{
+					setPalette(x, v);
+				}
+				else
+				{
+					uint8 grey = v == trnsSample(0) ? 0 : (uint8)(v * 255 / maxval);
+					rgb[x * 3 + 0] = rgb[x * 3 + 1] = rgb[x * 3 + 2] = grey;
+				}
+			}
+			return;
+		}
+		// for 16 bit samples the high byte comes first, which is all we need for the colour
+		const int stride = depth / 8;
+		auto sample = [stride](const uint8* p) { return stride == 2 ? (p[0] << 8) | p[1] : p[0]; };
+		for (int x = 0; x < numpixels; ++x)
+		{
+			const uint8* pix = row + x * channels * stride;
+			if (hdr.m_colortype == 0)
+			{
+				uint8 grey = sample(pix) == trnsSample(0) ? 0 : pix[0];
+				rgb[x * 3 + 0] = rgb[x * 3 + 1] = rgb[x * 3 + 2] = grey;
+			}
+			else if (hdr.m_colortype == 4)
+			{
+				uint8 grey = applyAlpha(pix[0], pix[stride]);
+				rgb[x * 3 + 0] = rgb[x * 3 + 1] = rgb[x * 3 + 2] = grey;
+			}
+			else if (hdr.m_colortype == 3)
+			{
+				setPalette(x, pix[0]);
+			}
+			else
+			{
+				int alpha = 255;
+				if (hdr.m_colortype == 6)
+					alpha = pix[3 * stride];
+				else if (sample(pix) == trnsSample(0) && sample(pix + stride) == trnsSample(1) && sample(pix + 2 * stride) == trnsSample(2))
+					alpha = 0;
+				rgb[x * 3 + 0] = applyAlpha(pix[0], alpha);
+				rgb[x * 3 + 1] = applyAlpha(pix[stride], alpha);
+				rgb[x * 3 + 2] = applyAlpha(pix[2 * stride], alpha);
+			}
+		}
+	}
+
+	// Returns nullptr if the stream is not a PNG this decoder handles, so the caller can fall back
+	std::shared_ptr<Image2MIDICellGrid> loadPNGStreaming(InputStream& in, int gridsize)
+	{
+		uint8 sig[8];
+		if (in.read(sig, 8) != 8 || memcmp(sig, pngsignature, 8) != 0)
+			return nullptr;
+		PNGHeader hdr;
+		std::vector<uint8> palette;
+		std::vector<uint8> trns;
+		uint32 firstidatlen = 0;
+		bool foundidat = false;
+		while (in.isExhausted() == false)
+		{
+			uint32 len = (uint32)in.readIntBigEndian();
+			char type[4];
+			// the specification limits chunk lengths to 2^31 - 1
+			if (in.read(type, 4) != 4 || len > 0x7fffffff)
+				return nullptr;
+			if (isChunkType(type, "IHDR"))
+			{
+				if (len < 13)
+					return nullptr;
+				hdr.m_width = in.readIntBigEndian();
+				hdr.m_height = in.readIntBigEndian();
+				hdr.m_bitdepth = (uint8)in.readByte();
+				hdr.m_colortype = (uint8)in.readByte();
+				in.skipNextBytes(2); // compression and filter method, only one of each is defined
+				hdr.m_interlace = (uint8)in.readByte();
+				in.skipNextBytes((int64)len - 13 + 4);
+				if (hdr.isValid() == false)
+					return nullptr;
+			}
+			else if (isChunkType(type, "PLTE"))
+			{
+				if (len == 0 || len > 768 || len % 3 != 0)
+					return nullptr;
+				palette.resize(len);
+				if (readFully(in, palette.data(), (int)len) == false)
+					return nullptr;
+				in.skipNextBytes(4);
+			}
+			else if (isChunkType(type, "tRNS"))
+			{
+				// one alpha per palette entry, or one 16 bit grey or RGB sample
+				const uint32 maxlen = hdr.m_colortype == 3 ? 256 : hdr.m_colortype == 0 ? 2 : hdr.m_colortype == 2 ? 6 : 0;
+				if (len > maxlen)
+					return nullptr;
+				trns.resize(len);
+				if (readFully(in, trns.data(), (int)len) == false)
+					return nullptr;
+				in.skipNextBytes(4);
+			}
+			else if (isChunkType(type, "IDAT"))
+			{
+				firstidatlen = len;
+				foundidat = true;
+				break;
+			}
+			else if (isChunkType(type, "IEND"))
+				return nullptr;
+			else in.skipNextBytes((int64)len + 4);
+		}
+		// Adam7 interlaced images would need the whole image before any row is complete
+		if (foundidat == false || hdr.isValid() == false || hdr.m_interlace != 0 || hdr.m_width < 1 || hdr.m_height < 1)
+			return nullptr;
+		if (hdr.m_colortype == 3 && palette.empty() == true)
+			return nullptr;
+		// anything this large is left to the JUCE decoder to reject
+		const int64 rowbytes64 = ((int64)hdr.m_width * hdr.getChannels() * hdr.m_bitdepth + 7) / 8;
+		if (hdr.m_width > (1 << 24) || (int64)hdr.m_width * hdr.m_height > ((int64)1 << 30) || rowbytes64 > (1 << 27))
+			return nullptr;
+		auto grid = makeEmptyGrid(hdr.m_width, hdr.m_height, gridsize);
+		if (grid->m_cols == 0 || grid->m_rows == 0)
+			return grid;
+		const int bitsperpixel = hdr.getChannels() * hdr.m_bitdepth;
+		const int rowbytes = (int)rowbytes64;
+		const int bpp = jmax(1, bitsperpixel / 8);
+		const int usedwidth = grid->m_cols * gridsize;
+		const int usedheight = grid->m_rows * gridsize;
+		std::vector<uint8> prev(rowbytes, 0);
+		std::vector<uint8> cur(rowbytes, 0);
+		std::vector<uint8> rgb(usedwidth * 3);
+		PNGIdatInputStream idat(in, firstidatlen);
+		GZIPDecompressorInputStream inflater(&idat, false, GZIPDecompressorInputStream::zlibFormat);
+		CellRowAccumulator accum(*grid);
+		// rows below the last full row of cells are never used, so decoding stops there
+		for (int y = 0; y < usedheight; ++y)
+		{
+			uint8 filtertype = 0;
+			if (readFully(inflater, &filtertype, 1) == false || readFully(inflater, cur.data(), rowbytes) == false)
+				return std::make_shared<Image2MIDICellGrid>();
+			if (unfilterScanline(filtertype, cur.data(), prev.data(), rowbytes, bpp) == false)
+				return std::make_shared<Image2MIDICellGrid>();
+			scanlineToRGB(hdr, cur.data(), palette, trns, rgb.data(), usedwidth);
+			accum.addScanline(rgb.data(), y);
+			std::swap(cur, prev);
+		}
+		return grid;
+	}
+}
+
+std::shared_ptr<Image2MIDICellGrid> analyseImage2MIDICellGrid(const Image& img, int gridsize)
+{
+	if (img.isValid() == false)
+		return std::make_shared<Image2MIDICellGrid>();
+	auto grid = makeEmptyGrid(img.getWidth(), img.getHeight(), gridsize);
+	if (grid->m_cols == 0 || grid->m_rows == 0)
+		return grid;
+	const int usedwidth = grid->m_cols * gridsize;
+	std::vector<uint8> rgb(usedwidth * 3);
+	CellRowAccumulator accum(*grid);
+	Image::BitmapData bitmap(img, Image::BitmapData::readOnly);
+	for (int y = 0; y < grid->m_rows * gridsize; ++y)
+	{
+		for (int x = 0; x < usedwidth; ++x)
+		{
+			// getPixelColour unpremultiplies, the alpha goes back in the same way as in the PNG decoder
+			Colour c = bitmap.getPixelColour(x, y);
+			rgb[x * 3 + 0] = applyAlpha(c.getRed(), c.getAlpha());
+			rgb[x * 3 + 1] = applyAlpha(c.getGreen(), c.getAlpha());
+			rgb[x * 3 + 2] = applyAlpha(c.getBlue(), c.getAlpha());
+		}
+		accum.addScanline(rgb.data(), y);
+	}
+	return grid;
+}
+
+std::shared_ptr<Image2MIDICellGrid> loadImage2MIDICellGrid(const File& file, int gridsize)
+{
+	if (gridsize < 1)
+		return std::make_shared<Image2MIDICellGrid>();
+	{
+		FileInputStream in(file);
+		if (in.openedOk() == false)
+			return std::make_shared<Image2MIDICellGrid>();
+		auto grid = loadPNGStreaming(in, gridsize);
+		if (grid != nullptr)
+			return grid;
+	}
+	return analyseImage2MIDICellGrid(ImageFileFormat::loadFrom(file), gridsize);
+}
+
+bool canLoadImage2MIDIFile(const File& file)
+{
+	FileInputStream in(file);
+	if (in.openedOk() == false)
+		return false;
+	return ImageFileFormat::findImageFormatForStream(in) != nullptr;
+}
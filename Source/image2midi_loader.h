@@ -0,0 +1,16 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "image2midi_analysis.h"
+
+// Builds the cell grid for an image file without keeping the full resolution image in memory.
+// Non-interlaced PNG files are decoded one scanline at a time and each scanline is folded into
+// the current row of cells, so the peak memory use is two scanlines plus the grid itself.
+// Other formats can't be decoded incrementally with JUCE and are decoded in full before reducing.
+std::shared_ptr<Image2MIDICellGrid> loadImage2MIDICellGrid(const File& file, int gridsize);
+
+// Reduces an already decoded image into the cell grid
+std::shared_ptr<Image2MIDICellGrid> analyseImage2MIDICellGrid(const Image& img, int gridsize);
+
+// Cheap check that only looks at the file header
+bool canLoadImage2MIDIFile(const File& file);
@@ -0,0 +1,81 @@
+#include "interned_strings.h"
+
+StringPool g_string_pool;
+
+namespace
+{
+	// FNV-1a over the UTF-8 bytes, so both overloads of intern hash without converting
+	uint64 hashUTF8(const char* utf8)
+	{
+		uint64 h = 14695981039346656037ULL;
+		for (; *utf8 != 0; ++utf8)
+		{
+			h ^= (uint8)*utf8;
+			h *= 1099511628211ULL;
+		}
+		return h;
+	}
+}
+
+StringPool::StringPool()
+{
+	m_chunks[0].reset(new Entry[chunkSize]);
+	m_num_entries = 1;
+}
+
+uint32 StringPool::intern(const char* utf8)
+{
+	if (utf8 == nullptr || *utf8 == 0)
+		return 0;
+	const uint64 hash = hashUTF8(utf8);
+	std::lock_guard<std::mutex> lock(m_mutex);
+	uint32 id = find(hash, utf8);
+	if (id != 0)
+		return id;
+	return add(hash, String(CharPointer_UTF8(utf8)));
+}
+
+uint32 StringPool::intern(const String& s)
+{
+	if (s.isEmpty())
+		return 0;
+	const char* utf8 = s.toRawUTF8();
+	const uint64 hash = hashUTF8(utf8);
+	std::lock_guard<std::mutex> lock(m_mutex);
+	uint32 id = find(hash, utf8);
+	if (id != 0)
+		return id;
+	// shares the storage of s
+	return add(hash, s);
+}
+
+uint32 StringPool::find(uint64 hash, const char* utf8) const
+{
+	auto range = m_lookup.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it)
+		if (strcmp(get(it->second).toRawUTF8(), utf8) == 0)
+			return it->second;
+	return 0;
+}
+
+uint32 StringPool::add(uint64 hash, const String& s)
+{
+	const uint32 id = m_num_entries.load();
+	const int chunk = (int)(id >> chunkBits);
+	if (chunk >= maxChunks)
+	{
+		jassertfalse;
+		return 0;
+	}
+	if (m_chunks[chunk] == nullptr)
+		m_chunks[chunk].reset(new Entry[chunkSize]);
+	Entry& e = m_chunks[chunk][id & (chunkSize - 1)];
+	e.m_str = s;
+	String lower = s.toLowerCase();
+	// most names have capitals, the ones that don't share their storage
+	e.m_lower = lower == s ? s : lower;
+	m_lookup.emplace(hash, id);
+	m_num_bytes += s.getNumBytesAsUTF8() * 2 + sizeof(Entry);
+	m_num_entries = id + 1;
+	return id;
+}
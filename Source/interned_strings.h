@@ -0,0 +1,66 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include <mutex>
+#include <unordered_map>
+
+// Process wide table that stores each distinct name once. Ids are stable until the plugin is
+// unloaded, so they can be kept and compared instead of the strings. The lowercase form is made
+// once when a string is added, so case insensitive matching does not convert per comparison.
+// Id 0 is the empty string.
+class StringPool
+{
+public:
+	StringPool();
+	// any thread
+	uint32 intern(const char* utf8);
+	uint32 intern(const String& s);
+	// any thread, for ids returned by intern
+	const String& get(uint32 id) const { return getEntry(id).m_str; }
+	const String& getLowerCase(uint32 id) const { return getEntry(id).m_lower; }
+	int getNumStrings() const { return (int)m_num_entries.load(); }
+	size_t getNumBytes() const { return m_num_bytes.load(); }
+private:
+	struct Entry
+	{
+		String m_str;
+		String m_lower;
+	};
+	static const int chunkBits = 12;
+	static const int chunkSize = 1 << chunkBits;
+	static const int maxChunks = 4096;
+	const Entry& getEntry(uint32 id) const { return m_chunks[id >> chunkBits][id & (chunkSize - 1)]; }
+	uint32 find(uint64 hash, const char* utf8) const;
+	uint32 add(uint64 hash, const String& s);
+	// entries never move once added, so get needs no lock
+	std::unique_ptr<Entry[]> m_chunks[maxChunks];
+	std::unordered_multimap<uint64, uint32> m_lookup;
+	std::mutex m_mutex;
+	std::atomic<uint32> m_num_entries{ 0 };
+	std::atomic<size_t> m_num_bytes{ 0 };
+};
+
+extern StringPool g_string_pool;
+
+// Handle to a string in g_string_pool, the size of an int and compared by id
+class InternedString
+{
+public:
+	InternedString() {}
+	explicit InternedString(const char* utf8) : m_id(g_string_pool.intern(utf8)) {}
+	explicit InternedString(const String& s) : m_id(g_string_pool.intern(s)) {}
+	static InternedString fromId(uint32 id)
+	{
+		InternedString result;
+		result.m_id = id;
+		return result;
+	}
+	const String& get() const { return g_string_pool.get(m_id); }
+	const String& getLowerCase() const { return g_string_pool.getLowerCase(m_id); }
+	uint32 getId() const { return m_id; }
+	bool isEmpty() const { return m_id == 0; }
+	bool operator==(const InternedString& other) const { return m_id == other.m_id; }
+	bool operator!=(const InternedString& other) const { return m_id != other.m_id; }
+private:
+	uint32 m_id = 0;
+};
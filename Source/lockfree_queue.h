@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+// Bounded multi-producer multi-consumer queue (Dmitry Vyukov's design). push and pop never
+// block or allocate, a full queue makes push fail instead. The capacity is rounded up to
+// a power of two.
+template<typename T>
+class LockFreeQueue
+{
+public:
+	explicit LockFreeQueue(size_t capacity)
+	{
+		size_t cap = 2;
+		while (cap < capacity)
+			cap *= 2;
+		m_mask = cap - 1;
+		m_cells.reset(new Cell[cap]);
+		for (size_t i = 0; i < cap; ++i)
+			m_cells[i].m_sequence.store(i, std::memory_order_relaxed);
+	}
+	LockFreeQueue(const LockFreeQueue&) = delete;
+	LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+	bool push(const T& x)
+	{
+		size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+		Cell* cell = nullptr;
+		for (;;)
+		{
+			cell = &m_cells[pos & m_mask];
+			size_t seq = cell->m_sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+			if (diff == 0)
+			{
+				if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+				return false; // full
+			else pos = m_enqueue_pos.load(std::memory_order_relaxed);
+		}
+		cell->m_data = x;
+		cell->m_sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+	bool pop(T& x)
+	{
+		size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+		Cell* cell = nullptr;
+		for (;;)
+		{
+			cell = &m_cells[pos & m_mask];
+			size_t seq = cell->m_sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+			if (diff == 0)
+			{
+				if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+				return false; // empty
+			else pos = m_dequeue_pos.load(std::memory_order_relaxed);
+		}
+		x = cell->m_data;
+		cell->m_sequence.store(pos + m_mask + 1, std::memory_order_release);
+		return true;
+	}
+	size_t capacity() const { return m_mask + 1; }
+	// Only a snapshot, other threads may change it at any moment
+	size_t sizeApprox() const
+	{
+		size_t enq = m_enqueue_pos.load(std::memory_order_relaxed);
+		size_t deq = m_dequeue_pos.load(std::memory_order_relaxed);
+		return enq >= deq ? enq - deq : 0;
+	}
+private:
+	struct Cell
+	{
+		std::atomic<size_t> m_sequence;
+		T m_data;
+	};
+	std::unique_ptr<Cell[]> m_cells;
+	size_t m_mask = 0;
+	alignas(64) std::atomic<size_t> m_enqueue_pos{ 0 };
+	alignas(64) std::atomic<size_t> m_dequeue_pos{ 0 };
+};
+
+// Bounded single-producer single-consumer queue. Wait-free on both sides : push and pop are a
+// few loads and stores, with no retry loops, so the producer can be a realtime thread.
+// The capacity is rounded up to a power of two.
+template<typename T>
+class SPSCQueue
+{
+public:
+	explicit SPSCQueue(size_t capacity)
+	{
+		size_t cap = 2;
+		while (cap < capacity)
+			cap *= 2;
+		m_mask = cap - 1;
+		m_data.reset(new T[cap]);
+	}
+	SPSCQueue(const SPSCQueue&) = delete;
+	SPSCQueue& operator=(const SPSCQueue&) = delete;
+	// Only from the producer thread
+	bool push(const T& x)
+	{
+		size_t w = m_write_pos.load(std::memory_order_relaxed);
+		if (w - m_read_pos.load(std::memory_order_acquire) > m_mask)
+			return false; // full
+		m_data[w & m_mask] = x;
+		m_write_pos.store(w + 1, std::memory_order_release);
+		return true;
+	}
+	// Only from the consumer thread
+	bool pop(T& x)
+	{
+		size_t r = m_read_pos.load(std::memory_order_relaxed);
+		if (r == m_write_pos.load(std::memory_order_acquire))
+			return false; // empty
+		x = m_data[r & m_mask];
+		m_read_pos.store(r + 1, std::memory_order_release);
+		return true;
+	}
+	size_t capacity() const { return m_mask + 1; }
+private:
+	std::unique_ptr<T[]> m_data;
+	size_t m_mask = 0;
+	alignas(64) std::atomic<size_t> m_write_pos{ 0 };
+	alignas(64) std::atomic<size_t> m_read_pos{ 0 };
+};
@@ -0,0 +1,396 @@
+#include "loudness_scanner.h"
+#include "source_reader.h"
+#include "reaper_plugin_functions.h"
+
+#if JUCE_INTEL
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+#if JUCE_INTEL
+	inline __m128d load2(const double* p)
+	{
+		return _mm_loadu_pd(p);
+	}
+	inline __m128d load2(const float* p)
+	{
+		return _mm_cvtps_pd(_mm_castpd_ps(_mm_load_sd((const double*)p)));
+	}
+#endif
+}
+
+LoudnessMeter::LoudnessMeter(int numchannels, double samplerate) : m_num_channels(numchannels)
+{
+	// BS.1770 pre-filter and RLB high pass, recomputed for the sample rate as libebur128 does
+	double f0 = 1681.974450955533;
+	double gain = 3.999843853973347;
+	double q = 0.7071752369554196;
+	double k = std::tan(MathConstants<double>::pi * f0 / samplerate);
+	double vh = std::pow(10.0, gain / 20.0);
+	double vb = std::pow(vh, 0.4996667741545416);
+	double a0 = 1.0 + k / q + k * k;
+	m_shelf.m_b0 = (vh + vb * k / q + k * k) / a0;
+	m_shelf.m_b1 = 2.0 * (k * k - vh) / a0;
+	m_shelf.m_b2 = (vh - vb * k / q + k * k) / a0;
+	m_shelf.m_a1 = 2.0 * (k * k - 1.0) / a0;
+	m_shelf.m_a2 = (1.0 - k / q + k * k) / a0;
+	f0 = 38.13547087602444;
+	q = 0.5003270373238773;
+	k = std::tan(MathConstants<double>::pi * f0 / samplerate);
+	a0 = 1.0 + k / q + k * k;
+	m_highpass.m_b0 = 1.0;
+	m_highpass.m_b1 = -2.0;
+	m_highpass.m_b2 = 1.0;
+	m_highpass.m_a1 = 2.0 * (k * k - 1.0) / a0;
+	m_highpass.m_a2 = (1.0 - k / q + k * k) / a0;
+	m_states.assign(numchannels * 4, 0.0);
+	m_channel_energies.assign(numchannels + 1, 0.0);
+	m_channel_weights.assign(numchannels, 1.0);
+	// 5.1 in the usual order : the LFE does not count and the surrounds are weighted up
+	if (numchannels == 6)
+	{
+		m_channel_weights[3] = 0.0;
+		m_channel_weights[4] = 1.41;
+		m_channel_weights[5] = 1.41;
+	}
+	m_subblock_len = jmax(1, roundToInt(samplerate * 0.1));
+}
+
+void LoudnessMeter::processSegment(const ReaSample* x, int numframes)
+{
+	const int nch = m_num_channels;
+	int c = 0;
+#if JUCE_INTEL
+	const __m128d sb0 = _mm_set1_pd(m_shelf.m_b0), sb1 = _mm_set1_pd(m_shelf.m_b1), sb2 = _mm_set1_pd(m_shelf.m_b2);
+	const __m128d sa1 = _mm_set1_pd(m_shelf.m_a1), sa2 = _mm_set1_pd(m_shelf.m_a2);
+	const __m128d ha1 = _mm_set1_pd(m_highpass.m_a1), ha2 = _mm_set1_pd(m_highpass.m_a2);
+	const __m128d two = _mm_set1_pd(2.0);
+	const __m128d absmask = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL));
+	for (; c + 2 <= nch; c += 2)
+	{
+		// states of channel c and c+1 side by side in the lanes
+		__m128d s1 = _mm_set_pd(m_states[(c + 1) * 4 + 0], m_states[c * 4 + 0]);
+		__m128d s2 = _mm_set_pd(m_states[(c + 1) * 4 + 1], m_states[c * 4 + 1]);
+		__m128d h1 = _mm_set_pd(m_states[(c + 1) * 4 + 2], m_states[c * 4 + 2]);
+		__m128d h2 = _mm_set_pd(m_states[(c + 1) * 4 + 3], m_states[c * 4 + 3]);
+		__m128d energy = _mm_setzero_pd();
+		__m128d peak = _mm_setzero_pd();
+		const ReaSample* p = x + c;
+		for (int i = 0; i < numframes; ++i, p += nch)
+		{
+			__m128d in = load2(p);
+			peak = _mm_max_pd(peak, _mm_and_pd(in, absmask));
+			__m128d y = _mm_add_pd(_mm_mul_pd(sb0, in), s1);
+			s1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(sb1, in), _mm_mul_pd(sa1, y)), s2);
+			s2 = _mm_sub_pd(_mm_mul_pd(sb2, in), _mm_mul_pd(sa2, y));
+			// high pass b coefficients are 1, -2, 1
+			__m128d z = _mm_add_pd(y, h1);
+			h1 = _mm_sub_pd(h2, _mm_add_pd(_mm_mul_pd(two, y), _mm_mul_pd(ha1, z)));
+			h2 = _mm_sub_pd(y, _mm_mul_pd(ha2, z));
+			energy = _mm_add_pd(energy, _mm_mul_pd(z, z));
+		}
+		double tmp[2];
+		_mm_storeu_pd(tmp, s1);
+		m_states[c * 4 + 0] = tmp[0];
+		m_states[(c + 1) * 4 + 0] = tmp[1];
+		_mm_storeu_pd(tmp, s2);
+		m_states[c * 4 + 1] = tmp[0];
+		m_states[(c + 1) * 4 + 1] = tmp[1];
+		_mm_storeu_pd(tmp, h1);
+		m_states[c * 4 + 2] = tmp[0];
+		m_states[(c + 1) * 4 + 2] = tmp[1];
+		_mm_storeu_pd(tmp, h2);
+		m_states[c * 4 + 3] = tmp[0];
+		m_states[(c + 1) * 4 + 3] = tmp[1];
+		_mm_storeu_pd(tmp, energy);
+		m_channel_energies[c] += tmp[0];
+		m_channel_energies[c + 1] += tmp[1];
+		_mm_storeu_pd(tmp, peak);
+		m_peak = jmax(m_peak, tmp[0], tmp[1]);
+	}
+#endif
+	for (; c < nch; ++c)
+	{
+		double* st = &m_states[c * 4];
+		double energy = 0.0;
+		double peak = m_peak;
+		const ReaSample* p = x + c;
+		for (int i = 0; i < numframes; ++i, p += nch)
+		{
+			double in = *p;
+			peak = jmax(peak, std::abs(in));
+			double y = m_shelf.m_b0 * in + st[0];
+			st[0] = m_shelf.m_b1 * in - m_shelf.m_a1 * y + st[1];
+			st[1] = m_shelf.m_b2 * in - m_shelf.m_a2 * y;
+			double z = y + st[2];
+			st[2] = -2.0 * y - m_highpass.m_a1 * z + st[3];
+			st[3] = y - m_highpass.m_a2 * z;
+			energy += z * z;
+		}
+		m_channel_energies[c] += energy;
+		m_peak = peak;
+	}
+}
+
+void LoudnessMeter::process(const ReaSample* interleaved, int numframes)
+{
+	int pos = 0;
+	while (pos < numframes)
+	{
+		int n = jmin(numframes - pos, m_subblock_len - m_subblock_pos);
+		processSegment(interleaved + (size_t)pos * m_num_channels, n);
+		pos += n;
+		m_subblock_pos += n;
+		if (m_subblock_pos == m_subblock_len)
+		{
+			double sum = 0.0;
+			for (int c = 0; c < m_num_channels; ++c)
+			{
+				sum += m_channel_weights[c] * m_channel_energies[c];
+				m_channel_energies[c] = 0.0;
+			}
+			m_subblock_energies.push_back(sum);
+			m_subblock_pos = 0;
+		}
+	}
+}
+
+double LoudnessMeter::getIntegratedLoudness() const
+{
+	// 400 ms blocks overlapping by 75 %, made of 4 consecutive 100 ms sub blocks
+	std::vector<double> blocks;
+	for (size_t i = 3; i < m_subblock_energies.size(); ++i)
+	{
+		double e = m_subblock_energies[i - 3] + m_subblock_energies[i - 2] + m_subblock_energies[i - 1] + m_subblock_energies[i];
+		blocks.push_back(e / (4.0 * m_subblock_len));
+	}
+	auto toLUFS = [](double meansquare) { return -0.691 + 10.0 * std::log10(meansquare); };
+	const double absolutegate = std::pow(10.0, (-70.0 + 0.691) / 10.0);
+	double sum = 0.0;
+	int count = 0;
+	for (double b : blocks)
+	{
+		if (b > absolutegate)
+		{
+			sum += b;
+			++count;
+		}
+	}
+	if (count == 0)
+		return -std::numeric_limits<double>::infinity();
+	const double relativegate = sum / count * std::pow(10.0, -10.0 / 10.0);
+	sum = 0.0;
+	count = 0;
+	for (double b : blocks)
+	{
+		if (b > absolutegate && b > relativegate)
+		{
+			sum += b;
+			++count;
+		}
+	}
+	if (count == 0)
+		return -std::numeric_limits<double>::infinity();
+	return toLUFS(sum / count);
+}
+
+LoudnessScanner::LoudnessScanner(std::vector<LoudnessScanItem> items) : m_items(std::move(items)),
+	m_tasks(*g_task_pool, "Loudness scan", TaskPriority::Batch)
+{
+}
+
+LoudnessScanner::~LoudnessScanner()
+{
+	m_tasks.cancel();
+	m_tasks.wait();
+}
+
+void LoudnessScanner::scanItem(LoudnessScanItem& item)
+{
+	SourceReader reader(item.m_filename);
+	if (reader.isValid() == true)
+	{
+		LoudnessMeter meter(reader.getNumChannels(), reader.getSampleRate());
+		reader.seek(item.m_source_start);
+		reader.setEnd(item.m_source_start + item.m_source_length);
+		// large blocks keep the per call overhead of the decoders small
+		std::vector<ReaSample> buffer;
+		while (m_tasks.isCancelled() == false)
+		{
+			int n = reader.readNext(65536, buffer);
+			if (n <= 0)
+				break;
+			meter.process(buffer.data(), n);
+		}
+		item.m_lufs = meter.getIntegratedLoudness();
+		item.m_peak = meter.getSamplePeak();
+		item.m_ok = m_tasks.isCancelled() == false;
+	}
+	if (++m_num_done == (int)m_items.size())
+		postFinish();
+}
+
+std::vector<LoudnessScanItem> LoudnessScanner::collectItems(bool selectedonly)
+{
+	std::vector<LoudnessScanItem> result;
+	for (int i = 0; i < CountMediaItems(nullptr); ++i)
+	{
+		MediaItem* item = GetMediaItem(nullptr, i);
+		if (selectedonly == true && IsMediaItemSelected(item) == false)
+			continue;
+		MediaItem_Take* take = GetActiveTake(item);
+		if (take == nullptr)
+			continue;
+		LoudnessScanItem scanitem;
+		scanitem.m_filename = getTakeSourceFileName(take);
+		if (scanitem.m_filename.isEmpty())
+			continue;
+		scanitem.m_item = item;
+		scanitem.m_name = String(CharPointer_UTF8(GetTakeName(take)));
+		double playrate = *(double*)GetSetMediaItemTakeInfo(take, "D_PLAYRATE", nullptr);
+		scanitem.m_source_start = *(double*)GetSetMediaItemTakeInfo(take, "D_STARTOFFS", nullptr);
+		scanitem.m_source_length = *(double*)GetSetMediaItemInfo(item, "D_LENGTH", nullptr) * playrate;
+		result.push_back(scanitem);
+	}
+	return result;
+}
+
+void LoudnessScanner::start()
+{
+	m_start_time = Time::getMillisecondCounterHiRes();
+	for (auto& item : m_items)
+	{
+		LoudnessScanItem* it = &item;
+		m_tasks.add([this, it]() { scanItem(*it); });
+	}
+	if (m_items.empty() == true)
+		postFinish();
+}
+
+void LoudnessScanner::postFinish()
+{
+	m_finish_pending = m_main_thread.post([this]() { finish(); }) == false;
+}
+
+void LoudnessScanner::retryFinish()
+{
+	if (m_finish_pending.exchange(false) == true)
+		postFinish();
+}
+
+void LoudnessScanner::finish()
+{
+	if (OnFinished)
+		OnFinished(m_items);
+}
+
+LoudnessScannerComponent::LoudnessScannerComponent()
+{
+	addAndMakeVisible(&m_scan_project_button);
+	m_scan_project_button.setButtonText("Scan project");
+	m_scan_project_button.addListener(this);
+	addAndMakeVisible(&m_scan_selected_button);
+	m_scan_selected_button.setButtonText("Scan selected");
+	m_scan_selected_button.addListener(this);
+	addAndMakeVisible(&m_status_label);
+	addAndMakeVisible(&m_list);
+	m_list.setModel(this);
+	m_list.setRowHeight(18);
+	m_list.setColour(ListBox::backgroundColourId, Colours::white);
+	setSize(300, 300); // need some initial size, so Juce does not assert
+}
+
+void LoudnessScannerComponent::resized()
+{
+	m_scan_project_button.setBounds(1, 1, 100, 22);
+	m_scan_selected_button.setBounds(m_scan_project_button.getRight() + 2, 1, 100, 22);
+	m_status_label.setBounds(m_scan_selected_button.getRight() + 2, 1, getWidth() - m_scan_selected_button.getRight() - 3, 22);
+	m_list.setBounds(0, 25, getWidth(), getHeight() - 25);
+}
+
+void LoudnessScannerComponent::buttonClicked(Button* but)
+{
+	if (but == &m_scan_project_button)
+		startScan(false);
+	if (but == &m_scan_selected_button)
+		startScan(true);
+}
+
+void LoudnessScannerComponent::startScan(bool selectedonly)
+{
+	if (m_scanner != nullptr)
+		return;
+	auto items = LoudnessScanner::collectItems(selectedonly);
+	if (items.empty() == true)
+	{
+		m_status_label.setText("No audio items to scan", dontSendNotification);
+		return;
+	}
+	m_scanner = std::make_unique<LoudnessScanner>(std::move(items));
+	m_scanner->OnFinished = [this](const std::vector<LoudnessScanItem>& results)
+	{
+		m_results = results;
+		m_status_label.setText(String((int)m_results.size()) + " items scanned in " + String(m_scanner->getElapsedSeconds(), 2) + " s",
+			dontSendNotification);
+		m_list.updateContent();
+		m_list.repaint();
+		stopTimer();
+		m_scan_project_button.setEnabled(true);
+		m_scan_selected_button.setEnabled(true);
+		// can't destroy the scanner from inside its own callback
+		Component::SafePointer<LoudnessScannerComponent> safethis(this);
+		MessageManager::callAsync([safethis]()
+		{
+			if (safethis != nullptr)
+				safethis->m_scanner = nullptr;
+		});
+	};
+	m_scan_project_button.setEnabled(false);
+	m_scan_selected_button.setEnabled(false);
+	m_scanner->start();
+	startTimer(100);
+}
+
+void LoudnessScannerComponent::timerCallback()
+{
+	if (m_scanner == nullptr)
+		return;
+	m_scanner->retryFinish();
+	m_status_label.setText("Scanning " + String(m_scanner->getNumDone()) + "/" + String(m_scanner->getNumItems()), dontSendNotification);
+}
+
+int LoudnessScannerComponent::getNumRows()
+{
+	return (int)m_results.size();
+}
+
+void LoudnessScannerComponent::paintListBoxItem(int row, Graphics& g, int w, int h, bool selected)
+{
+	if (row < 0 || row >= (int)m_results.size())
+		return;
+	if (selected)
+		g.fillAll(Colours::lightblue);
+	auto& r = m_results[row];
+	g.setColour(Colours::black);
+	g.drawText(r.m_name, 2, 0, w - 164, h, Justification::centredLeft);
+	if (r.m_ok == false)
+	{
+		g.drawText("could not read", w - 160, 0, 158, h, Justification::centredRight);
+		return;
+	}
+	auto formatdB = [](double v) { return std::isfinite(v) ? String(v, 1) : String("-inf"); };
+	g.drawText(formatdB(r.m_lufs) + " LUFS", w - 160, 0, 78, h, Justification::centredRight);
+	g.setColour(r.m_peak > 1.0 ? Colours::red : Colours::black);
+	g.drawText(formatdB(Decibels::gainToDecibels(r.m_peak, -std::numeric_limits<double>::infinity())) + " dBFS", w - 80, 0, 78, h, Justification::centredRight);
+}
+
+void LoudnessScannerComponent::listBoxItemDoubleClicked(int row, const MouseEvent&)
+{
+	if (row < 0 || row >= (int)m_results.size() || ValidatePtr(m_results[row].m_item, "MediaItem*") == false)
+		return;
+	// select just the double clicked item in the arrange view
+	SelectAllMediaItems(nullptr, false);
+	SetMediaItemSelected(m_results[row].m_item, true);
+	UpdateArrange();
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "reaper_plugin.h"
+#include "task_pool.h"
+#include "main_thread_tasks.h"
+
+// ITU-R BS.1770 integrated loudness and sample peak of interleaved audio. The K-weighting
+// filters run on two channels at a time with SSE2. Energies are kept per 100 ms, from which
+// the gated 400 ms blocks are formed at the end.
+class LoudnessMeter
+{
+public:
+	LoudnessMeter(int numchannels, double samplerate);
+	void process(const ReaSample* interleaved, int numframes);
+	// In LUFS, -infinity when everything was gated away
+	double getIntegratedLoudness() const;
+	double getSamplePeak() const { return m_peak; }
+private:
+	struct Biquad
+	{
+		double m_b0 = 1.0, m_b1 = 0.0, m_b2 = 0.0, m_a1 = 0.0, m_a2 = 0.0;
+	};
+	void processSegment(const ReaSample* x, int numframes);
+	Biquad m_shelf;
+	Biquad m_highpass;
+	int m_num_channels = 0;
+	// 4 filter states per channel, shelf s1 s2 and highpass s1 s2
+	std::vector<double> m_states;
+	std::vector<double> m_channel_weights;
+	std::vector<double> m_channel_energies;
+	std::vector<double> m_subblock_energies;
+	int m_subblock_len = 0;
+	int m_subblock_pos = 0;
+	double m_peak = 0.0;
+};
+
+struct LoudnessScanItem
+{
+	MediaItem* m_item = nullptr;
+	String m_name;
+	String m_filename;
+	double m_source_start = 0.0; // seconds into the source file
+	double m_source_length = 0.0;
+	bool m_ok = false;
+	double m_lufs = 0.0;
+	double m_peak = 0.0;
+};
+
+// Measures project items on the shared task pool. Each task opens the take's source file on its own,
+// and the last one to finish posts the results to OnFinished on the main thread in one batch.
+class LoudnessScanner
+{
+public:
+	LoudnessScanner(std::vector<LoudnessScanItem> items);
+	~LoudnessScanner();
+	// Audio takes of the project's items, MIDI and non file sources are left out
+	static std::vector<LoudnessScanItem> collectItems(bool selectedonly);
+	void start();
+	int getNumItems() const { return (int)m_items.size(); }
+	int getNumDone() const { return m_num_done.load(); }
+	double getElapsedSeconds() const { return (Time::getMillisecondCounterHiRes() - m_start_time) / 1000.0; }
+	// Posts the finish again if the main thread task queue was full when the last item was done.
+	// Called from the owner's timer.
+	void retryFinish();
+	std::function<void(const std::vector<LoudnessScanItem>&)> OnFinished;
+private:
+	void scanItem(LoudnessScanItem& item);
+	void postFinish();
+	void finish();
+	std::vector<LoudnessScanItem> m_items;
+	std::atomic<int> m_num_done{ 0 };
+	double m_start_time = 0.0;
+	std::atomic<bool> m_finish_pending{ false };
+	MainThreadTaskToken m_main_thread;
+	TaskGroup m_tasks;
+};
+
+class LoudnessScannerComponent : public Component, public ListBoxModel, public Button::Listener, private Timer
+{
+public:
+	LoudnessScannerComponent();
+	void resized() override;
+	int getNumRows() override;
+	void paintListBoxItem(int row, Graphics& g, int w, int h, bool selected) override;
+	void listBoxItemDoubleClicked(int row, const MouseEvent& e) override;
+	void buttonClicked(Button* but) override;
+private:
+	void timerCallback() override;
+	void startScan(bool selectedonly);
+	TextButton m_scan_project_button;
+	TextButton m_scan_selected_button;
+	Label m_status_label;
+	ListBox m_list;
+	std::unique_ptr<LoudnessScanner> m_scanner;
+	std::vector<LoudnessScanItem> m_results;
+};
@@ -8,6 +8,15 @@
 #include "JuceHeader.h"
 #include "xy_component.h"
 #include "image2midi.h"
+#include "audio2midi.h"
+#include "csurf_logger.h"
+#include "audio_meter.h"
+#include "loudness_scanner.h"
+#include "time_stretch.h"
+#include "my_surface.h"
+#include "main_thread_tasks.h"
+#include "task_pool.h"
+#include "action_macro.h"
 
 HINSTANCE g_hInst;
 HWND g_parent;
@@ -34,6 +43,22 @@ public:
 	int m_valhw = 0;
 	int m_relmode = 0;
 	toggle_state m_togglestate = CannotToggle;
+	// Value actions that set this run at most once per timer tick, with the net value of the
+	// messages that arrived since the previous tick
+	bool m_coalesce_values = false;
+	// Summed steps of relative messages, and how many messages the current run stands for
+	int m_delta = 0;
+	int m_num_coalesced = 1;
+	struct PendingValue
+	{
+		int m_count = 0;
+		bool m_relative = false;
+		int m_val = 0;
+		int m_valhw = -1;
+		int m_relmode = 0;
+		int m_delta = 0;
+	};
+	PendingValue m_pending;
 	void* m_data = nullptr;
 	template<typename T>
 	T* getDataAs() { return static_cast<T*>(m_data); }
@@ -149,7 +174,13 @@ class CSurfLoggerWindow;
 std::unique_ptr<Window> g_xy_wnd;
 std::unique_ptr<Window> g_rubberband_wnd;
 std::unique_ptr<Window> g_image2midi_wnd;
+std::unique_ptr<Window> g_audio2midi_wnd;
 std::unique_ptr<Window> g_csurflogger_wnd;
+std::unique_ptr<Window> g_audiometer_wnd;
+std::unique_ptr<Window> g_loudness_wnd;
+
+std::unique_ptr<TaskPool> g_task_pool;
+std::unique_ptr<ActionMacroEngine> g_macro_engine;
 
 std::unique_ptr<Window> makeWindow(String name, Component* component, int w, int h, bool resizable, Colour backGroundColor)
 {
@@ -168,104 +199,154 @@ std::unique_ptr<Window> makeWindow(String name, Component* component, int w, int
 	return win;
 }
 
-class UserInputsDialog : public Component, public Button::Listener
+// Rows are ListBox rows, so only the visible ones have components, and forms with hundreds of
+// fields open as fast as small ones. The values live in a StringArray, not in the editors.
+class UserInputsDialog : public Component, public ListBoxModel, public Button::Listener
 {
 public:
-	struct field_t
-	{
-		field_t(String lbl, String initial)
-		{
-			m_label.setText(lbl, dontSendNotification);
-			m_line_edit.setText(initial, dontSendNotification);
-			m_line_edit.setColour(TextEditor::textColourId, Colours::black);
-			m_line_edit.applyColourToAllText(Colours::black, true);
-		}
-		Label m_label;
-		TextEditor m_line_edit;
-	};
-	UserInputsDialog()
+	UserInputsDialog(StringArray labels, StringArray initialentries, std::function<void(StringArray)> callback = nullptr)
+		: m_labels(labels), m_values(initialentries), m_callback(callback)
 	{
+		setLookAndFeel(&m_lookandfeel);
+		while (m_values.size() < m_labels.size())
+			m_values.add(String());
+		addAndMakeVisible(&m_list);
+		m_list.setModel(this);
+		m_list.setRowHeight(25);
+		m_list.setColour(ListBox::backgroundColourId, Colours::lightgrey);
 		addAndMakeVisible(&m_ok_button);
 		m_ok_button.setButtonText("OK");
 		m_ok_button.addListener(this);
 		addAndMakeVisible(&m_cancel_button);
 		m_cancel_button.setButtonText("Cancel");
 		m_cancel_button.addListener(this);
+		setSize(320, jmin(m_labels.size(), 20) * 25 + 30);
 	}
-	void buttonClicked(Button* but) override
+	~UserInputsDialog()
 	{
-		DialogWindow* dw = findParentComponentOfClass<DialogWindow>();
-		if (dw == nullptr)
-			return;
-		if (but == &m_ok_button)
+		// closed from the title bar
+		if (m_finished == false && m_callback)
+			m_callback(StringArray());
+		m_list.setModel(nullptr);
+		setLookAndFeel(nullptr);
+	}
+	int getNumRows() override { return m_labels.size(); }
+	void paintListBoxItem(int row, Graphics& g, int w, int h, bool selected) override {}
+	Component* refreshComponentForRow(int row, bool selected, Component* existing) override
+	{
+		auto rowcomp = dynamic_cast<RowComponent*>(existing);
+		if (row < 0 || row >= m_labels.size())
 		{
-			dw->exitModalState(1);
+			delete existing;
+			return nullptr;
 		}
-		if (but == &m_cancel_button)
+		if (rowcomp == nullptr)
 		{
-			dw->exitModalState(2);
+			delete existing;
+			rowcomp = new RowComponent(*this);
 		}
+		rowcomp->setRow(row);
+		return rowcomp;
 	}
-
-	void addEntry(String lbl, String initial)
+	void buttonClicked(Button* but) override
 	{
-		auto entry = std::make_shared<field_t>(lbl, initial);
-		addAndMakeVisible(&entry->m_label);
-		addAndMakeVisible(&entry->m_line_edit);
-		m_entries.push_back(entry);
+		if (but == &m_ok_button)
+			finish(1);
+		if (but == &m_cancel_button)
+			finish(2);
 	}
 	void resized() override
 	{
-		int entryh = 25;
-		int labelw = 150;
-		for (int i=0;i<m_entries.size();++i)
-		{
-			m_entries[i]->m_label.setBounds(1, i*entryh, labelw, entryh - 1);
-			m_entries[i]->m_line_edit.setBounds(1+labelw+2, i*entryh, 150, entryh - 1);
-		}
+		m_list.setBounds(0, 0, getWidth(), getHeight() - 27);
 		m_ok_button.setBounds(1, getHeight() - 25, 60, 24);
 		m_cancel_button.setBounds(m_ok_button.getRight() + 1, m_ok_button.getY(), 60, 24);
 	}
-	StringArray getResults()
+	StringArray getResults() const { return m_values; }
+private:
+	class RowComponent : public Component
 	{
-		StringArray results;
-		for (auto& e : m_entries)
-			results.add(e->m_line_edit.getText());
-		return results;
+	public:
+		RowComponent(UserInputsDialog& owner) : m_owner(owner)
+		{
+			addAndMakeVisible(&m_label);
+			addAndMakeVisible(&m_line_edit);
+			m_line_edit.setColour(TextEditor::textColourId, Colours::black);
+			m_line_edit.onTextChange = [this]() { m_owner.m_values.set(m_row, m_line_edit.getText()); };
+		}
+		void setRow(int row)
+		{
+			m_row = row;
+			m_label.setText(m_owner.m_labels[row], dontSendNotification);
+			m_line_edit.setText(m_owner.m_values[row], dontSendNotification);
+		}
+		void resized() override
+		{
+			int labelw = 150;
+			m_label.setBounds(1, 0, labelw, getHeight() - 1);
+			m_line_edit.setBounds(1 + labelw + 2, 0, getWidth() - labelw - 4, getHeight() - 1);
+		}
+	private:
+		UserInputsDialog& m_owner;
+		int m_row = 0;
+		Label m_label;
+		TextEditor m_line_edit;
+	};
+	void finish(int result)
+	{
+		m_finished = true;
+		if (m_callback)
+			m_callback(result == 1 ? m_values : StringArray());
+		if (DialogWindow* dw = findParentComponentOfClass<DialogWindow>())
+			dw->exitModalState(result);
 	}
-private:
-	std::vector<std::shared_ptr<field_t>> m_entries;
+	LookAndFeel_V3 m_lookandfeel;
+	StringArray m_labels;
+	StringArray m_values;
+	std::function<void(StringArray)> m_callback;
+	bool m_finished = false;
+	ListBox m_list;
 	TextButton m_ok_button;
 	TextButton m_cancel_button;
 };
 
 StringArray GetUserInputsEx(String windowtitle, StringArray labels, StringArray initialentries)
 {
-	LookAndFeel_V3 lookandfeel;
-	auto dlg = std::make_unique<UserInputsDialog>();
-	dlg->setLookAndFeel(&lookandfeel);
-	for (int i = 0; i < labels.size(); ++i)
-	{
-		if (i < initialentries.size())
-		{
-			dlg->addEntry(labels[i], initialentries[i]);
-		}
-	}
-	dlg->setSize(320, labels.size() * 25 + 30);
+	auto dlg = std::make_unique<UserInputsDialog>(labels, initialentries);
 	int r = DialogWindow::showModalDialog(windowtitle, dlg.get(), nullptr, Colours::lightgrey, true);
 	if (r == 1)
 		return dlg->getResults();
 	return StringArray();
 }
 
+// Returns right away, the callback gets the entries when the dialog is closed, or an empty array
+// if it was cancelled
+void GetUserInputsExAsync(String windowtitle, StringArray labels, StringArray initialentries,
+	std::function<void(StringArray)> callback)
+{
+	DialogWindow::LaunchOptions options;
+	options.content.setOwned(new UserInputsDialog(labels, initialentries, callback));
+	options.dialogTitle = windowtitle;
+	options.dialogBackgroundColour = Colours::lightgrey;
+	options.resizable = true;
+	options.launchAsync();
+}
+
 void testUserInputs()
 {
-	auto r = GetUserInputsEx("test", { "field 1","field 2" }, { "0.0","0.1" });
-	for (auto& e : r)
+	StringArray labels;
+	StringArray initial;
+	for (int i = 0; i < 500; ++i)
 	{
-		ShowConsoleMsg(e.toRawUTF8());
-		ShowConsoleMsg("\n");
+		labels.add("field " + String(i + 1));
+		initial.add(String(i * 0.1, 1));
 	}
+	GetUserInputsExAsync("test", labels, initial, [](StringArray r)
+	{
+		String txt = "User inputs : " + String(r.size()) + " entries\n";
+		for (int i = 0; i < jmin(r.size(), 10); ++i)
+			txt << r[i] << "\n";
+		ShowConsoleMsg(txt.toRawUTF8());
+	});
 }
 
 void toggleXYWindow(action_entry& ae)
@@ -290,75 +371,192 @@ void toggleImage2MIDIWindow(action_entry& ae)
 
 
 
-class CSurfLoggerComponent : public Component
+void toggleAudio2MIDIWindow(action_entry& ae)
 {
-public:
-	CSurfLoggerComponent()
+	if (g_audio2midi_wnd == nullptr)
 	{
-		addAndMakeVisible(&m_ed);
-		m_ed.setMultiLine(true);
-		m_ed.setReadOnly(true);
-		setSize(300, 300); // need some initial size, so Juce does not assert
+		g_audio2midi_wnd = makeWindow("Audio2MIDI", new Audio2MIDIGUI, 400, 200, true, Colours::lightgrey);
+		g_audio2midi_wnd->m_assoc_action = &ae;
 	}
-	void resized() override
+	g_audio2midi_wnd->setVisible(!g_audio2midi_wnd->isVisible());
+}
+
+void toggleCSurfLoggerWindow(action_entry& ae)
+{
+	if (g_csurflogger_wnd == nullptr)
 	{
-		m_ed.setBounds(0, 0, getWidth(), getHeight());
+		g_csurflogger_wnd = makeWindow("CSurf Logger", new CSurfLoggerComponent, 400, 400, true, Colours::lightgrey);
+		g_csurflogger_wnd->m_assoc_action = &ae;
 	}
-	void addMessage(String txt)
+	g_csurflogger_wnd->setVisible(!g_csurflogger_wnd->isVisible());
+}
+
+void toggleAudioMeterWindow(action_entry& ae)
+{
+	if (g_audiometer_wnd == nullptr)
 	{
-		m_ed.insertTextAtCaret(txt);
-		m_ed.setCaretPosition(m_ed.getText().length());
+		g_audiometer_wnd = makeWindow("Audio Meters", new AudioMeterComponent, 400, 400, true, Colours::darkgrey);
+		g_audiometer_wnd->m_assoc_action = &ae;
 	}
-private:
-	TextEditor m_ed;
-};
+	g_audiometer_wnd->setVisible(!g_audiometer_wnd->isVisible());
+}
 
-class MySurface : public IReaperControlSurface
+void toggleLoudnessScannerWindow(action_entry& ae)
 {
-public:
-
-	void SetSurfaceSelected(MediaTrack *trackid, bool selected) override
+	if (g_loudness_wnd == nullptr)
 	{
-		if (g_csurflogger_wnd == nullptr)
-			return;
-		auto comp = g_csurflogger_wnd->getComponentAs<CSurfLoggerComponent>();
-		if (selected)
-			comp->addMessage("track " + String((int64_t)trackid) + " selected\n");
-		else comp->addMessage("track " + String((int64_t)trackid) + " unselected\n");
+		g_loudness_wnd = makeWindow("Loudness Scanner", new LoudnessScannerComponent, 500, 400, true, Colours::lightgrey);
+		g_loudness_wnd->m_assoc_action = &ae;
 	}
-	// Inherited via IReaperControlSurface
-	virtual const char * GetTypeString() override
+	g_loudness_wnd->setVisible(!g_loudness_wnd->isVisible());
+}
+
+void toggleTimeStretchWindow(action_entry& ae)
+{
+	if (g_rubberband_wnd == nullptr)
 	{
-		return "mysurf";
+		g_rubberband_wnd = makeWindow("Time stretch / pitch render", new TimeStretchComponent, 300, 110, true, Colours::lightgrey);
+		g_rubberband_wnd->m_assoc_action = &ae;
 	}
+	g_rubberband_wnd->setVisible(!g_rubberband_wnd->isVisible());
+}
+
+void checkMixerStateMirror()
+{
+	if (g_my_surface == nullptr)
+		return;
+	StringArray diffs = g_my_surface->getMixerState().checkConsistency();
+	String txt = "Mixer state mirror : " + String(diffs.size()) + " differences\n";
+	for (auto& e : diffs)
+		txt << e << "\n";
+	txt << "String pool : " << g_string_pool.getNumStrings() << " names, " << String((int64)(g_string_pool.getNumBytes() / 1024)) << " kB\n";
+	ShowConsoleMsg(txt.toRawUTF8());
+}
 
-	virtual const char * GetDescString() override
+void showMainThreadTaskStats()
+{
+	auto s = g_main_thread_tasks.getStats();
+	String txt = "Main thread tasks : " + String(s.m_executed) + " run, " + String(s.m_posted) + " posted, "
+		+ String(s.m_rejected) + " rejected\n";
+	txt << "Queue depth " << (int)s.m_depth << ", max " << (int)s.m_max_depth << "\n";
+	txt << "Wait " << String(s.m_avg_wait, 2) << " ms average, " << String(s.m_max_wait, 2) << " ms max, last drain took "
+		<< String(s.m_last_drain_time, 2) << " ms\n";
+	ShowConsoleMsg(txt.toRawUTF8());
+}
+
+void showTaskPoolStats()
+{
+	String txt = "Task pool : " + String(g_task_pool->getNumThreads()) + " workers, "
+		+ String(g_task_pool->getNumQueued()) + " tasks queued\n";
+	for (auto& e : g_task_pool->getStats())
 	{
-		return "My Surface";
+		auto& s = e.second;
+		double n = (double)jmax<int64>(1, s.m_count);
+		txt << e.first << " : " << String(s.m_count) << " run, " << String(s.m_skipped) << " skipped, "
+			<< String(s.m_total_run / n, 2) << " ms average, " << String(s.m_max_run, 2) << " ms max, "
+			<< String(s.m_total_wait / n, 2) << " ms average wait\n";
 	}
+	ShowConsoleMsg(txt.toRawUTF8());
+}
 
-	virtual const char * GetConfigString() override
+// Settings are "transport|osc host|osc port|midi output index|rate", kept in the REAPER ext state
+void applySurfaceFeedbackSettings(StringArray settings)
+{
+	if (g_my_surface == nullptr || settings.size() < 5)
+		return;
+	String transport = settings[0].trim().toLowerCase();
+	std::unique_ptr<FeedbackTransport> t;
+	if (transport == "osc")
+		t = std::make_unique<OSCFeedbackTransport>(settings[1].trim(), settings[2].getIntValue());
+	else if (transport == "midi")
 	{
-		return "";
+		std::unique_ptr<MidiOutput> output(MidiOutput::openDevice(settings[3].getIntValue()));
+		if (output == nullptr)
+			ShowConsoleMsg("Surface feedback : could not open MIDI output\n");
+		else t = std::make_unique<MIDIFeedbackTransport>(std::move(output));
 	}
+	else if (transport == "loopback")
+		t = std::make_unique<LoopbackFeedbackTransport>();
+	g_my_surface->getFeedbackEngine().setRate(settings[4].getDoubleValue());
+	g_my_surface->setFeedbackTransport(std::move(t));
+}
 
-};
-
-void toggleCSurfLoggerWindow(action_entry& ae)
+void configureSurfaceFeedback()
 {
-	if (g_csurflogger_wnd == nullptr)
+	Window::initMessageManager();
+	StringArray current = StringArray::fromTokens(GetExtState("juce_test", "surface_feedback"), "|", "");
+	if (current.size() < 5)
+		current = { "none", "127.0.0.1", "9000", "0", "30" };
+	GetUserInputsExAsync("Control surface feedback",
+		{ "osc/midi/loopback/none", "OSC host", "OSC port", "MIDI output index", "Rate (Hz)" }, current, [](StringArray r)
 	{
-		g_csurflogger_wnd = makeWindow("CSurf Logger", new CSurfLoggerComponent, 400, 400, true, Colours::lightgrey);
-		g_csurflogger_wnd->m_assoc_action = &ae;
-	}
-	g_csurflogger_wnd->setVisible(!g_csurflogger_wnd->isVisible());
+		if (r.size() < 5)
+			return;
+		SetExtState("juce_test", "surface_feedback", r.joinIntoString("|").toRawUTF8(), true);
+		applySurfaceFeedbackSettings(r);
+		if (auto t = g_my_surface->getFeedbackEngine().getTransport())
+			ShowConsoleMsg(("Surface feedback : sending to " + t->getName() + "\n").toRawUTF8());
+	});
 }
 
 void onActionWithValue(action_entry& ae)
 {
-	char buf[256];
-	sprintf(buf, "%d %d %d\n", ae.m_val, ae.m_valhw, ae.m_relmode);
-	ShowConsoleMsg(buf);
+	String txt = "MIDI/OSC action : ";
+	if (ae.m_relmode == 0)
+		txt << "absolute " << ae.m_val << " hw " << ae.m_valhw;
+	else txt << "relative " << (ae.m_delta > 0 ? "+" : "") << ae.m_delta << " mode " << ae.m_relmode;
+	txt << ", " << ae.m_num_coalesced << " messages\n";
+	ShowConsoleMsg(txt.toRawUTF8());
+}
+
+// Signed step count of a message in one of REAPER's relative modes
+int decodeRelativeValue(int val, int relmode)
+{
+	if (relmode == 1) // 127 = -1, 1 = +1
+		return val >= 64 ? val - 128 : val;
+	if (relmode == 2) // 63 = -1, 65 = +1
+		return val - 64;
+	if (relmode == 3) // 65 = -1, 1 = +1
+		return (val & 64) != 0 ? -(val & 63) : val;
+	return 0;
+}
+
+void runPendingValueAction(action_entry& e)
+{
+	auto& p = e.m_pending;
+	if (p.m_count == 0)
+		return;
+	e.m_val = p.m_val;
+	e.m_valhw = p.m_valhw;
+	e.m_relmode = p.m_relmode;
+	e.m_delta = p.m_delta;
+	e.m_num_coalesced = p.m_count;
+	p = action_entry::PendingValue();
+	e.m_func(e);
+}
+
+// Registered as a REAPER timer, runs each coalesced value action once with what arrived since the last tick
+void runCoalescedValueActions()
+{
+	for (auto& e : g_actions)
+		if (e->m_coalesce_values == true)
+			runPendingValueAction(*e);
+}
+
+void accumulateValue(action_entry& e, int val, int valhw, int relmode)
+{
+	auto& p = e.m_pending;
+	const bool relative = relmode != 0;
+	// absolute and relative values don't combine, what is pending runs first
+	if (p.m_count > 0 && p.m_relative != relative)
+		runPendingValueAction(e);
+	p.m_relative = relative;
+	p.m_val = val;
+	p.m_valhw = valhw;
+	p.m_relmode = relmode;
+	if (relative == true)
+		p.m_delta += decodeRelativeValue(val, relmode);
+	++p.m_count;
 }
 
 bool on_value_action(KbdSectionInfo *sec, int command, int val, int valhw, int relmode, HWND hwnd)
@@ -367,9 +565,16 @@ bool on_value_action(KbdSectionInfo *sec, int command, int val, int valhw, int r
 	{
 		if (e->m_command_id != 0 && e->m_command_id == command) {
 			Window::initMessageManager();
+			if (e->m_coalesce_values == true)
+			{
+				accumulateValue(*e, val, valhw, relmode);
+				return true;
+			}
 			e->m_val = val;
 			e->m_valhw = valhw;
 			e->m_relmode = relmode;
+			e->m_delta = relmode != 0 ? decodeRelativeValue(val, relmode) : 0;
+			e->m_num_coalesced = 1;
 			e->m_func(*e);
 			return true;
 		}
@@ -378,6 +583,75 @@ bool on_value_action(KbdSectionInfo *sec, int command, int val, int valhw, int r
 }
 
 
+bool runExtensionAction(int command)
+{
+	for (auto& e : g_actions)
+	{
+		if (e->m_command_id != 0 && e->m_command_id == command)
+		{
+			Window::initMessageManager();
+			e->m_delta = 0;
+			e->m_num_coalesced = 1;
+			e->m_func(*e);
+			return true;
+		}
+	}
+	return false;
+}
+
+void registerMacroAction(ActionMacro& macro)
+{
+	if (macro.m_command_id != 0)
+		return;
+	// the id must stay the same between sessions for shortcuts and toolbars to keep working
+	auto e = add_action("JUCE test macro : " + macro.m_name.toStdString(),
+		"JUCETEST_MACRO_" + String::toHexString(macro.m_name.hashCode()).toStdString(), CannotToggle, [](action_entry& ae)
+	{
+		if (auto m = g_macro_engine->findMacroByCommand(ae.m_command_id))
+			g_macro_engine->run(*m);
+	});
+	macro.m_command_id = e->m_command_id;
+}
+
+void addActionMacro(String name, StringArray steps)
+{
+	if (ActionMacroEngine::isValidName(name) == false)
+	{
+		ShowConsoleMsg(("Macro " + name + " : the name can not contain | ; or ,\n").toRawUTF8());
+		return;
+	}
+	ActionMacro& macro = g_macro_engine->addMacro(g_macro_engine->compile(name, steps));
+	if (macro.m_unresolved.size() > 0)
+		ShowConsoleMsg(("Macro " + name + " : unknown actions " + macro.m_unresolved.joinIntoString(", ") + "\n").toRawUTF8());
+	registerMacroAction(macro);
+}
+
+// Registered as a timer for one tick, by then the other extensions have registered their actions
+void compileStoredMacros()
+{
+	g_plugin_info->Register("-timer", (void*)compileStoredMacros);
+	g_macro_engine->compilePending();
+	for (int i = 0; i < g_macro_engine->getNumMacros(); ++i)
+	{
+		auto& macro = g_macro_engine->getMacro(i);
+		if (macro.m_unresolved.size() > 0)
+			ShowConsoleMsg(("Macro " + macro.m_name + " : unknown actions " + macro.m_unresolved.joinIntoString(", ") + "\n").toRawUTF8());
+	}
+}
+
+void defineActionMacro()
+{
+	Window::initMessageManager();
+	GetUserInputsExAsync("Define action macro", { "Name", "Actions (command ids or names, comma separated)" }, { "", "" },
+		[](StringArray r)
+	{
+		if (r.size() < 2 || r[0].trim().isEmpty())
+			return;
+		addActionMacro(r[0].trim(), StringArray::fromTokens(r[1], ",", ""));
+		SetExtState("juce_test", "action_macros", g_macro_engine->serialize().toRawUTF8(), true);
+	});
+}
+
 extern "C"
 {
 	REAPER_PLUGIN_DLL_EXPORT int REAPER_PLUGIN_ENTRYPOINT(REAPER_PLUGIN_HINSTANCE hInstance, reaper_plugin_info_t *rec) {
@@ -401,31 +675,104 @@ extern "C"
 				toggleImage2MIDIWindow(ae);
 			});
 
+			add_action("JUCE test : Show/hide Audio2MIDI", "JUCETEST_SHOW_AUDIO2MIDI", ToggleOff, [](action_entry& ae)
+			{
+				toggleAudio2MIDIWindow(ae);
+			});
+
 			add_action("JUCE test : Show/hide CSurf Logger", "JUCETEST_SHOW_CSURFLOGGER", ToggleOff, [](action_entry& ae)
 			{
 				toggleCSurfLoggerWindow(ae);
 			});
 
+			add_action("JUCE test : Show/hide Audio Meters", "JUCETEST_SHOW_AUDIOMETERS", ToggleOff, [](action_entry& ae)
+			{
+				toggleAudioMeterWindow(ae);
+			});
+
+			add_action("JUCE test : Show/hide Loudness Scanner", "JUCETEST_SHOW_LOUDNESSSCANNER", ToggleOff, [](action_entry& ae)
+			{
+				toggleLoudnessScannerWindow(ae);
+			});
+
+			add_action("JUCE test : Show/hide Time stretch render", "JUCETEST_SHOW_RUBBERBAND", ToggleOff, [](action_entry& ae)
+			{
+				toggleTimeStretchWindow(ae);
+			});
+
 			add_action("JUCE test : Test user inputs", "JUCETEST_USERINPUTSEX", ToggleOff, [](action_entry& ae)
 			{
 				testUserInputs();
 			});
 
-			add_action("JUCE test : MIDI/OSC action test", "JUCETEST_MIDIOSCTEST", CannotToggle, onActionWithValue);
+			add_action("JUCE test : MIDI/OSC action test", "JUCETEST_MIDIOSCTEST", CannotToggle, onActionWithValue)->m_coalesce_values = true;
+
+			add_action("JUCE test : Configure control surface feedback", "JUCETEST_SURFACEFEEDBACK", CannotToggle, [](action_entry& ae)
+			{
+				configureSurfaceFeedback();
+			});
+
+			add_action("JUCE test : Check mixer state mirror", "JUCETEST_CHECKMIXERSTATE", CannotToggle, [](action_entry& ae)
+			{
+				checkMixerStateMirror();
+			});
+
+			add_action("JUCE test : Show main thread task queue statistics", "JUCETEST_MAINTHREADTASKSTATS", CannotToggle, [](action_entry& ae)
+			{
+				showMainThreadTaskStats();
+			});
+
+			add_action("JUCE test : Show task pool statistics", "JUCETEST_TASKPOOLSTATS", CannotToggle, [](action_entry& ae)
+			{
+				showTaskPoolStats();
+			});
+
+			add_action("JUCE test : Define action macro", "JUCETEST_DEFINEMACRO", CannotToggle, [](action_entry& ae)
+			{
+				defineActionMacro();
+			});
+
+			// the actions are registered now so shortcuts find them, the steps are resolved on the first timer tick
+			g_macro_engine = std::make_unique<ActionMacroEngine>(runExtensionAction);
+			for (auto& m : ActionMacroEngine::deserialize(GetExtState("juce_test", "action_macros")))
+				if (ActionMacroEngine::isValidName(m.first) == true)
+					registerMacroAction(g_macro_engine->declareMacro(m.first, m.second));
+			rec->Register("timer", (void*)compileStoredMacros);
 
 			rec->Register("hookcommand2", (void*)on_value_action);
 			rec->Register("toggleaction", (void*)toggleActionCallback);
-			MySurface* surf = new MySurface;
-			rec->Register("csurf_inst", surf);
+			rec->Register("timer", (void*)drainMainThreadTasks);
+			rec->Register("timer", (void*)runCoalescedValueActions);
+			g_task_pool = std::make_unique<TaskPool>(TaskPool::getDefaultNumWorkers());
+			g_my_surface = new MySurface;
+			rec->Register("csurf_inst", g_my_surface);
+			applySurfaceFeedbackSettings(StringArray::fromTokens(GetExtState("juce_test", "surface_feedback"), "|", ""));
 			return 1; // our plugin registered, return success
 		}
 		else
 		{
+			if (g_plugin_info != nullptr)
+			{
+				g_plugin_info->Register("-timer", (void*)drainMainThreadTasks);
+				g_plugin_info->Register("-timer", (void*)runCoalescedValueActions);
+				g_plugin_info->Register("-timer", (void*)compileStoredMacros);
+			}
+			// pending tasks may hold JUCE objects, so they go before JUCE shuts down
+			g_main_thread_tasks.clear();
 			if (g_juce_messagemanager_inited == true)
 			{
 				g_xy_wnd = nullptr;
 				g_rubberband_wnd = nullptr;
+				g_image2midi_wnd = nullptr;
 				g_csurflogger_wnd = nullptr;
+				g_audiometer_wnd = nullptr;
+				g_loudness_wnd = nullptr;
+				g_audio2midi_wnd = nullptr;
+			}
+			// after the windows, whose task groups wait for their running tasks
+			g_task_pool = nullptr;
+			if (g_juce_messagemanager_inited == true)
+			{
 				shutdownJuce_GUI();
 				g_juce_messagemanager_inited = false;
 			}
@@ -0,0 +1,79 @@
+#include "main_thread_tasks.h"
+
+MainThreadTaskQueue g_main_thread_tasks(4096);
+
+MainThreadTaskQueue::MainThreadTaskQueue(size_t capacity) : m_queue(capacity)
+{
+}
+
+MainThreadTaskQueue::~MainThreadTaskQueue()
+{
+	clear();
+}
+
+bool MainThreadTaskQueue::post(std::function<void(void)> task)
+{
+	Task* t = new Task{ std::move(task), Time::getMillisecondCounterHiRes() };
+	if (m_queue.push(t) == false)
+	{
+		delete t;
+		++m_rejected;
+		return false;
+	}
+	++m_posted;
+	size_t depth = m_queue.sizeApprox();
+	size_t maxdepth = m_max_depth.load();
+	while (depth > maxdepth && m_max_depth.compare_exchange_weak(maxdepth, depth) == false)
+		;
+	return true;
+}
+
+int MainThreadTaskQueue::drain(double budgetms)
+{
+	const double start = Time::getMillisecondCounterHiRes();
+	int count = 0;
+	Task* t = nullptr;
+	// at least one task per call, so a task longer than the budget can't block the queue forever
+	while (m_queue.pop(t) == true)
+	{
+		const double now = Time::getMillisecondCounterHiRes();
+		const double wait = now - t->m_post_time;
+		m_avg_wait = m_executed == 0 ? wait : m_avg_wait * 0.95 + wait * 0.05;
+		m_max_wait = jmax(m_max_wait, wait);
+		std::unique_ptr<Task> owned(t);
+		owned->m_func();
+		++m_executed;
+		++count;
+		if (Time::getMillisecondCounterHiRes() - start >= budgetms)
+			break;
+	}
+	if (count > 0)
+		m_last_drain_time = Time::getMillisecondCounterHiRes() - start;
+	return count;
+}
+
+void MainThreadTaskQueue::clear()
+{
+	Task* t = nullptr;
+	while (m_queue.pop(t) == true)
+		delete t;
+}
+
+MainThreadTaskQueue::Stats MainThreadTaskQueue::getStats() const
+{
+	Stats s;
+	s.m_depth = m_queue.sizeApprox();
+	s.m_max_depth = m_max_depth.load();
+	s.m_posted = m_posted.load();
+	s.m_rejected = m_rejected.load();
+	s.m_executed = m_executed;
+	s.m_avg_wait = m_avg_wait;
+	s.m_max_wait = m_max_wait;
+	s.m_last_drain_time = m_last_drain_time;
+	return s;
+}
+
+void drainMainThreadTasks()
+{
+	g_main_thread_tasks.drain(g_main_thread_tasks.getBudget());
+}
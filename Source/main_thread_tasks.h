@@ -0,0 +1,76 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "lockfree_queue.h"
+
+// Work posted from any thread to be run on REAPER's main thread, where the REAPER API may be called.
+// Drained with a time budget from the REAPER timer hook, so a burst of tasks is spread over several
+// UI ticks instead of stalling one of them.
+class MainThreadTaskQueue
+{
+public:
+	struct Stats
+	{
+		size_t m_depth = 0;
+		size_t m_max_depth = 0;
+		int64 m_posted = 0;
+		int64 m_rejected = 0;
+		int64 m_executed = 0;
+		// milliseconds between posting and running
+		double m_avg_wait = 0.0;
+		double m_max_wait = 0.0;
+		double m_last_drain_time = 0.0;
+	};
+	explicit MainThreadTaskQueue(size_t capacity);
+	~MainThreadTaskQueue();
+	// any thread, returns false if the queue is full
+	bool post(std::function<void(void)> task);
+	// main thread only, returns the number of tasks run
+	int drain(double budgetms);
+	// main thread only, drops the tasks without running them
+	void clear();
+	void setBudget(double ms) { m_budget = ms; }
+	double getBudget() const { return m_budget; }
+	// main thread only
+	Stats getStats() const;
+private:
+	struct Task
+	{
+		std::function<void(void)> m_func;
+		double m_post_time = 0.0;
+	};
+	LockFreeQueue<Task*> m_queue;
+	std::atomic<int64> m_posted{ 0 };
+	std::atomic<int64> m_rejected{ 0 };
+	std::atomic<size_t> m_max_depth{ 0 };
+	std::atomic<double> m_budget{ 5.0 };
+	int64 m_executed = 0;
+	double m_avg_wait = 0.0;
+	double m_max_wait = 0.0;
+	double m_last_drain_time = 0.0;
+};
+
+extern MainThreadTaskQueue g_main_thread_tasks;
+
+// Posts tasks on behalf of an object that may be destroyed before they run. The object keeps the
+// token as a member, and its pending tasks are skipped once it is gone. The owner has to be destroyed
+// on the main thread, where the tasks run.
+class MainThreadTaskToken
+{
+public:
+	// any thread, returns false if the queue is full
+	bool post(std::function<void(void)> task) const
+	{
+		std::weak_ptr<int> alive = m_alive;
+		return g_main_thread_tasks.post([alive, task]()
+		{
+			if (alive.lock() != nullptr)
+				task();
+		});
+	}
+private:
+	std::shared_ptr<int> m_alive = std::make_shared<int>(0);
+};
+
+// Registered as the REAPER "timer" hook
+void drainMainThreadTasks();
@@ -0,0 +1,211 @@
+#include "midi_bulk_writer.h"
+#include "reaper_plugin_functions.h"
+
+extern reaper_plugin_info_t* g_plugin_info;
+
+namespace
+{
+	// Not in the API header this project is built against, so it is looked up at runtime
+	typedef bool(*MIDI_SetAllEvts_t)(MediaItem_Take* take, const char* buf, int buf_sz);
+
+	MIDI_SetAllEvts_t getSetAllEvtsFunc()
+	{
+		static MIDI_SetAllEvts_t func = g_plugin_info != nullptr ?
+			(MIDI_SetAllEvts_t)g_plugin_info->GetFunc("MIDI_SetAllEvts") : nullptr;
+		return func;
+	}
+
+	struct PackedEvent
+	{
+		int64 m_pos = 0;
+		int m_order = 0; // note-offs before CCs before note-ons at the same position
+		uint8 m_flags = 0;
+		uint8 m_msg[3] = { 0,0,0 };
+		// sysex and text events, written instead of m_msg when not empty
+		std::vector<uint8> m_long;
+	};
+
+	void appendInt(MemoryBlock& buf, int v)
+	{
+		// the packed format is little endian on all REAPER platforms
+		uint32 le = ByteOrder::swapIfBigEndian((uint32)v);
+		buf.append(&le, 4);
+	}
+
+	// The end of the source, which the packed buffer has to mark or the source shrinks to the last event
+	double getSourceEndPPQ(MediaItem_Take* take)
+	{
+		PCM_source* src = GetMediaItemTake_Source(take);
+		if (src == nullptr)
+			return 0.0;
+		bool isqn = false;
+		double len = GetMediaSourceLength(src, &isqn);
+		if (isqn == true)
+			return MIDI_GetPPQPosFromProjQN(take, MIDI_GetProjQNFromPPQPos(take, 0.0) + len);
+		double playrate = jmax(0.0001, GetMediaItemTakeInfo_Value(take, "D_PLAYRATE"));
+		return MIDI_GetPPQPosFromProjTime(take, MIDI_GetProjTimeFromPPQPos(take, 0.0) + len / playrate);
+	}
+
+	// The packed buffer replaces everything, so the existing sysex and text events are read back into it
+	void collectTextSysexEvents(MediaItem_Take* take, std::vector<PackedEvent>& events)
+	{
+		int cnt1 = 0, cnt2 = 0, cnt3 = 0;
+		MIDI_CountEvts(take, &cnt1, &cnt2, &cnt3);
+		std::vector<char> msg(65536);
+		for (int i = 0; i < cnt3; ++i)
+		{
+			bool sel = false;
+			bool muted = false;
+			double ppq = 0.0;
+			int type = 0;
+			int msgsize = (int)msg.size();
+			if (MIDI_GetTextSysexEvt(take, i, &sel, &muted, &ppq, &type, msg.data(), &msgsize) == false)
+				continue;
+			msgsize = jlimit(0, (int)msg.size(), msgsize);
+			PackedEvent ev;
+			ev.m_pos = (int64)std::round(ppq);
+			ev.m_order = 1;
+			ev.m_flags = (sel ? 1 : 0) | (muted ? 2 : 0);
+			if (type == -1)
+			{
+				ev.m_long.push_back(0xf0);
+				ev.m_long.insert(ev.m_long.end(), msg.begin(), msg.begin() + msgsize);
+				ev.m_long.push_back(0xf7);
+			}
+			else
+			{
+				ev.m_long.push_back(0xff);
+				ev.m_long.push_back((uint8)type);
+				ev.m_long.insert(ev.m_long.end(), msg.begin(), msg.begin() + msgsize);
+			}
+			events.push_back(std::move(ev));
+		}
+	}
+}
+
+void MIDIBulkWriter::addNote(double startppq, double endppq, int chan, int pitch, int vel, bool selected, bool muted)
+{
+	NoteEntry e;
+	e.m_start = startppq;
+	e.m_end = jmax(startppq, endppq);
+	e.m_chan = (uint8)jlimit(0, 15, chan);
+	e.m_pitch = (uint8)jlimit(0, 127, pitch);
+	e.m_vel = (uint8)jlimit(1, 127, vel);
+	e.m_flags = (selected ? 1 : 0) | (muted ? 2 : 0);
+	m_notes.push_back(e);
+}
+
+void MIDIBulkWriter::addCC(double ppq, int chanmsg, int chan, int msg2, int msg3, bool selected, bool muted)
+{
+	CCEntry e;
+	e.m_pos = ppq;
+	e.m_status = (uint8)((chanmsg & 0xf0) | jlimit(0, 15, chan));
+	e.m_msg2 = (uint8)(msg2 & 0x7f);
+	e.m_msg3 = (uint8)(msg3 & 0x7f);
+	e.m_flags = (selected ? 1 : 0) | (muted ? 2 : 0);
+	m_ccs.push_back(e);
+}
+
+void MIDIBulkWriter::clear()
+{
+	m_notes.clear();
+	m_ccs.clear();
+}
+
+bool MIDIBulkWriter::replaceTakeEvents(MediaItem_Take* take)
+{
+	if (take == nullptr)
+		return false;
+	if (writePacked(take) == true)
+		return true;
+	writeWithInserts(take);
+	return true;
+}
+
+bool MIDIBulkWriter::writePacked(MediaItem_Take* take)
+{
+	MIDI_SetAllEvts_t setallevts = getSetAllEvtsFunc();
+	if (setallevts == nullptr)
+		return false;
+	std::vector<PackedEvent> events;
+	events.reserve(m_notes.size() * 2 + m_ccs.size());
+	collectTextSysexEvents(take, events);
+	for (auto& n : m_notes)
+	{
+		PackedEvent on;
+		on.m_pos = (int64)std::round(n.m_start);
+		on.m_order = 2;
+		on.m_flags = n.m_flags;
+		on.m_msg[0] = 0x90 | n.m_chan;
+		on.m_msg[1] = n.m_pitch;
+		on.m_msg[2] = n.m_vel;
+		events.push_back(on);
+		PackedEvent off = on;
+		off.m_pos = jmax(on.m_pos + 1, (int64)std::round(n.m_end));
+		off.m_order = 0;
+		off.m_msg[0] = 0x80 | n.m_chan;
+		off.m_msg[2] = 0;
+		events.push_back(off);
+	}
+	for (auto& c : m_ccs)
+	{
+		PackedEvent ev;
+		ev.m_pos = (int64)std::round(c.m_pos);
+		ev.m_order = 1;
+		ev.m_flags = c.m_flags;
+		ev.m_msg[0] = c.m_status;
+		ev.m_msg[1] = c.m_msg2;
+		ev.m_msg[2] = c.m_msg3;
+		events.push_back(ev);
+	}
+	std::stable_sort(events.begin(), events.end(), [](const PackedEvent& a, const PackedEvent& b)
+	{
+		if (a.m_pos != b.m_pos)
+			return a.m_pos < b.m_pos;
+		return a.m_order < b.m_order;
+	});
+	// all notes off marks the end of the source
+	PackedEvent endmarker;
+	endmarker.m_pos = (int64)std::round(getSourceEndPPQ(take));
+	if (events.empty() == false)
+		endmarker.m_pos = jmax(endmarker.m_pos, events.back().m_pos);
+	endmarker.m_msg[0] = 0xb0;
+	endmarker.m_msg[1] = 123;
+	events.push_back(endmarker);
+	MemoryBlock buf;
+	buf.ensureSize(events.size() * 12);
+	int64 lastpos = 0;
+	for (auto& ev : events)
+	{
+		appendInt(buf, (int)(ev.m_pos - lastpos));
+		lastpos = ev.m_pos;
+		buf.append(&ev.m_flags, 1);
+		if (ev.m_long.empty() == false)
+		{
+			appendInt(buf, (int)ev.m_long.size());
+			buf.append(ev.m_long.data(), ev.m_long.size());
+			continue;
+		}
+		// program change and channel pressure only have one data byte
+		int msglen = ((ev.m_msg[0] & 0xf0) == 0xc0 || (ev.m_msg[0] & 0xf0) == 0xd0) ? 2 : 3;
+		appendInt(buf, msglen);
+		buf.append(ev.m_msg, msglen);
+	}
+	return setallevts(take, (const char*)buf.getData(), (int)buf.getSize());
+}
+
+void MIDIBulkWriter::writeWithInserts(MediaItem_Take* take)
+{
+	int cnt1 = 0, cnt2 = 0, cnt3 = 0;
+	MIDI_CountEvts(take, &cnt1, &cnt2, &cnt3);
+	for (int i = cnt1 - 1; i >= 0; --i)
+		MIDI_DeleteNote(take, i);
+	for (int i = cnt2 - 1; i >= 0; --i)
+		MIDI_DeleteCC(take, i);
+	bool nosort = true;
+	for (auto& n : m_notes)
+		MIDI_InsertNote(take, (n.m_flags & 1) != 0, (n.m_flags & 2) != 0, n.m_start, n.m_end, n.m_chan, n.m_pitch, n.m_vel, &nosort);
+	for (auto& c : m_ccs)
+		MIDI_InsertCC(take, (c.m_flags & 1) != 0, (c.m_flags & 2) != 0, c.m_pos, c.m_status & 0xf0, c.m_status & 0x0f, c.m_msg2, c.m_msg3);
+	MIDI_Sort(take);
+}
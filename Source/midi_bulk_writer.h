@@ -0,0 +1,43 @@
+#pragma once
+
+#include "JuceHeader.h"
+
+class MediaItem_Take;
+
+// Collects notes and CCs and writes them into a take in one go. When the running REAPER
+// provides MIDI_SetAllEvts, the whole event list is handed over as a single packed buffer,
+// otherwise the events are inserted unsorted and the take is sorted once at the end.
+class MIDIBulkWriter
+{
+public:
+	void addNote(double startppq, double endppq, int chan, int pitch, int vel, bool selected = false, bool muted = false);
+	void addCC(double ppq, int chanmsg, int chan, int msg2, int msg3, bool selected = false, bool muted = false);
+	int getNumNotes() const { return (int)m_notes.size(); }
+	int getNumCCs() const { return (int)m_ccs.size(); }
+	void clear();
+	// Removes the existing notes and CCs (all channel messages) of the take and replaces them with
+	// the collected events. Sysex and text events are kept on both write paths.
+	bool replaceTakeEvents(MediaItem_Take* take);
+private:
+	struct NoteEntry
+	{
+		double m_start = 0.0;
+		double m_end = 0.0;
+		uint8 m_chan = 0;
+		uint8 m_pitch = 0;
+		uint8 m_vel = 0;
+		uint8 m_flags = 0;
+	};
+	struct CCEntry
+	{
+		double m_pos = 0.0;
+		uint8 m_status = 0;
+		uint8 m_msg2 = 0;
+		uint8 m_msg3 = 0;
+		uint8 m_flags = 0;
+	};
+	std::vector<NoteEntry> m_notes;
+	std::vector<CCEntry> m_ccs;
+	bool writePacked(MediaItem_Take* take);
+	void writeWithInserts(MediaItem_Take* take);
+};
@@ -0,0 +1,191 @@
+#include "mixer_state.h"
+#include "reaper_plugin_functions.h"
+
+namespace
+{
+	InternedString getTrackNameFromReaper(MediaTrack* track)
+	{
+		char buf[4096] = { 0 };
+		if (GetSetMediaTrackInfo_String(track, "P_NAME", buf, false) == false)
+			return InternedString();
+		return InternedString(buf);
+	}
+	uint8 getFlagsFromReaper(MediaTrack* track)
+	{
+		uint8 flags = 0;
+		if (*(bool*)GetSetMediaTrackInfo(track, "B_MUTE", nullptr) == true)
+			flags |= MixerStateMirror::Mute;
+		if (*(int*)GetSetMediaTrackInfo(track, "I_SOLO", nullptr) != 0)
+			flags |= MixerStateMirror::Solo;
+		if (*(int*)GetSetMediaTrackInfo(track, "I_SELECTED", nullptr) != 0)
+			flags |= MixerStateMirror::Selected;
+		if (*(int*)GetSetMediaTrackInfo(track, "I_RECARM", nullptr) != 0)
+			flags |= MixerStateMirror::RecArm;
+		return flags;
+	}
+}
+
+void MixerStateMirror::refreshIfNeeded()
+{
+	if (m_tracklist_dirty == true)
+		rebuild();
+}
+
+void MixerStateMirror::rebuild()
+{
+	int numtracks = CountTracks(nullptr);
+	m_tracks.resize(numtracks);
+	m_names.resize(numtracks);
+	m_volumes.resize(numtracks);
+	m_pans.resize(numtracks);
+	m_flags.resize(numtracks);
+	m_fx_valid.assign(numtracks, 0);
+	m_fx.resize(numtracks);
+	m_track_to_index.clear();
+	for (int i = 0; i < numtracks; ++i)
+	{
+		MediaTrack* track = GetTrack(nullptr, i);
+		m_tracks[i] = track;
+		m_track_to_index[track] = i;
+		m_names[i] = getTrackNameFromReaper(track);
+		m_volumes[i] = *(double*)GetSetMediaTrackInfo(track, "D_VOL", nullptr);
+		m_pans[i] = *(double*)GetSetMediaTrackInfo(track, "D_PAN", nullptr);
+		m_flags[i] = getFlagsFromReaper(track);
+	}
+	m_tracklist_dirty = false;
+	++m_num_rebuilds;
+}
+
+int MixerStateMirror::findTrackIndex(MediaTrack* track) const
+{
+	auto it = m_track_to_index.find(track);
+	if (it == m_track_to_index.end())
+		return -1;
+	return it->second;
+}
+
+void MixerStateMirror::setTrackName(MediaTrack* track, InternedString name)
+{
+	int index = findTrackIndex(track);
+	if (index >= 0)
+		m_names[index] = name;
+}
+
+void MixerStateMirror::setVolume(MediaTrack* track, double v)
+{
+	int index = findTrackIndex(track);
+	if (index >= 0)
+		m_volumes[index] = v;
+}
+
+void MixerStateMirror::setPan(MediaTrack* track, double v)
+{
+	int index = findTrackIndex(track);
+	if (index >= 0)
+		m_pans[index] = v;
+}
+
+void MixerStateMirror::setFlag(MediaTrack* track, TrackFlags f, bool state)
+{
+	int index = findTrackIndex(track);
+	if (index < 0)
+		return;
+	if (state == true)
+		m_flags[index] |= f;
+	else m_flags[index] &= ~f;
+}
+
+void MixerStateMirror::invalidateFX(MediaTrack* track)
+{
+	int index = findTrackIndex(track);
+	if (index >= 0)
+		m_fx_valid[index] = 0;
+}
+
+void MixerStateMirror::invalidateAllFX()
+{
+	std::fill(m_fx_valid.begin(), m_fx_valid.end(), 0);
+}
+
+void MixerStateMirror::readFX(int index)
+{
+	MediaTrack* track = m_tracks[index];
+	auto& fxlist = m_fx[index];
+	int numfx = TrackFX_GetCount(track);
+	fxlist.resize(numfx);
+	char buf[4096];
+	for (int i = 0; i < numfx; ++i)
+	{
+		TrackFX_GetFXName(track, i, buf, 4096);
+		fxlist[i].m_name = InternedString(buf);
+		int numparams = TrackFX_GetNumParams(track, i);
+		fxlist[i].m_param_names.resize(numparams);
+		// many instances of the same plugin, so mostly lookups of names already in the pool
+		for (int j = 0; j < numparams; ++j)
+		{
+			TrackFX_GetParamName(track, i, j, buf, 4096);
+			fxlist[i].m_param_names[j] = InternedString(buf);
+		}
+	}
+	m_fx_valid[index] = 1;
+}
+
+const std::vector<MixerStateFX>& MixerStateMirror::getFX(int index)
+{
+	if (m_fx_valid[index] == 0)
+		readFX(index);
+	return m_fx[index];
+}
+
+StringArray MixerStateMirror::checkConsistency()
+{
+	StringArray result;
+	if (m_tracklist_dirty == true)
+		return result; // would be rebuilt anyway before the next read
+	int numtracks = CountTracks(nullptr);
+	if (numtracks != getNumTracks())
+	{
+		result.add("track count " + String(getNumTracks()) + ", REAPER has " + String(numtracks));
+		return result;
+	}
+	for (int i = 0; i < numtracks; ++i)
+	{
+		MediaTrack* track = GetTrack(nullptr, i);
+		String prefix = "track " + String(i + 1) + " : ";
+		if (track != m_tracks[i])
+		{
+			result.add(prefix + "different track object");
+			continue;
+		}
+		InternedString name = getTrackNameFromReaper(track);
+		if (name != m_names[i])
+			result.add(prefix + "name \"" + m_names[i].get() + "\", REAPER has \"" + name.get() + "\"");
+		double vol = *(double*)GetSetMediaTrackInfo(track, "D_VOL", nullptr);
+		if (std::abs(vol - m_volumes[i]) > 1e-9)
+			result.add(prefix + "volume " + String(m_volumes[i]) + ", REAPER has " + String(vol));
+		double pan = *(double*)GetSetMediaTrackInfo(track, "D_PAN", nullptr);
+		if (std::abs(pan - m_pans[i]) > 1e-9)
+			result.add(prefix + "pan " + String(m_pans[i]) + ", REAPER has " + String(pan));
+		uint8 flags = getFlagsFromReaper(track);
+		if (flags != m_flags[i])
+			result.add(prefix + "mute/solo/selected/recarm flags " + String(m_flags[i]) + ", REAPER has " + String(flags));
+		if (m_fx_valid[i] == 0)
+			continue;
+		int numfx = TrackFX_GetCount(track);
+		if (numfx != (int)m_fx[i].size())
+		{
+			result.add(prefix + "fx count " + String((int)m_fx[i].size()) + ", REAPER has " + String(numfx));
+			continue;
+		}
+		char buf[4096];
+		for (int j = 0; j < numfx; ++j)
+		{
+			TrackFX_GetFXName(track, j, buf, 4096);
+			if (InternedString(buf) != m_fx[i][j].m_name)
+				result.add(prefix + "fx " + String(j + 1) + " name \"" + m_fx[i][j].m_name.get() + "\", REAPER has \"" + String(CharPointer_UTF8(buf)) + "\"");
+			if (TrackFX_GetNumParams(track, j) != (int)m_fx[i][j].m_param_names.size())
+				result.add(prefix + "fx " + String(j + 1) + " parameter count differs");
+		}
+	}
+	return result;
+}
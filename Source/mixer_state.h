@@ -0,0 +1,60 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "reaper_plugin.h"
+#include "interned_strings.h"
+#include <unordered_map>
+
+struct MixerStateFX
+{
+	InternedString m_name;
+	std::vector<InternedString> m_param_names;
+};
+
+// Mirror of the project's mixer state, kept up to date from the control surface callbacks so
+// that UI code does not need to query REAPER. The per track values are kept in parallel arrays
+// indexed like GetTrack(nullptr, index), the master track is not included. Everything here
+// runs on the main thread, like the surface callbacks.
+class MixerStateMirror
+{
+public:
+	enum TrackFlags { Mute = 1, Solo = 2, Selected = 4, RecArm = 8 };
+	// Call before reading, rebuilds the arrays when the track list has changed
+	void refreshIfNeeded();
+	int getNumTracks() const { return (int)m_tracks.size(); }
+	MediaTrack* getTrack(int index) const { return m_tracks[index]; }
+	const String& getTrackName(int index) const { return m_names[index].get(); }
+	InternedString getTrackNameHandle(int index) const { return m_names[index]; }
+	double getVolume(int index) const { return m_volumes[index]; }
+	double getPan(int index) const { return m_pans[index]; }
+	bool hasFlag(int index, TrackFlags f) const { return (m_flags[index] & f) != 0; }
+	// The FX of a track are read from REAPER on first use after a change
+	const std::vector<MixerStateFX>& getFX(int index);
+	// Returns -1 for tracks not in the mirror, the master track included
+	int findTrackIndex(MediaTrack* track) const;
+
+	void invalidateTrackList() { m_tracklist_dirty = true; }
+	void setTrackName(MediaTrack* track, InternedString name);
+	void setVolume(MediaTrack* track, double v);
+	void setPan(MediaTrack* track, double v);
+	void setFlag(MediaTrack* track, TrackFlags f, bool state);
+	void invalidateFX(MediaTrack* track);
+	void invalidateAllFX();
+
+	// Compares the mirror against REAPER and returns a description of every difference
+	StringArray checkConsistency();
+	int64 getNumRebuilds() const { return m_num_rebuilds; }
+private:
+	void rebuild();
+	void readFX(int index);
+	std::vector<MediaTrack*> m_tracks;
+	std::vector<InternedString> m_names;
+	std::vector<double> m_volumes;
+	std::vector<double> m_pans;
+	std::vector<uint8> m_flags;
+	std::vector<uint8> m_fx_valid;
+	std::vector<std::vector<MixerStateFX>> m_fx;
+	std::unordered_map<MediaTrack*, int> m_track_to_index;
+	bool m_tracklist_dirty = true;
+	int64 m_num_rebuilds = 0;
+};
@@ -0,0 +1,234 @@
+#include "my_surface.h"
+#include "reaper_plugin_functions.h"
+
+LockFreeQueue<CSurfEvent> g_csurf_event_queue(65536);
+std::atomic<bool> g_csurf_capture_enabled{ false };
+std::atomic<uint64> g_csurf_events_dropped{ 0 };
+MySurface* g_my_surface = nullptr;
+
+const char* MySurface::GetTypeString()
+{
+	return "mysurf";
+}
+
+const char* MySurface::GetDescString()
+{
+	return "My Surface";
+}
+
+const char* MySurface::GetConfigString()
+{
+	return "";
+}
+
+void MySurface::capture(CSurfEventType type, MediaTrack* track, double v0, double v1, int i0, int i1, int extcall)
+{
+	if (g_csurf_capture_enabled.load(std::memory_order_relaxed) == false)
+		return;
+	CSurfEvent ev;
+	ev.m_ticks = Time::getHighResolutionTicks();
+	ev.m_type = type;
+	ev.m_track = track;
+	ev.m_values[0] = v0;
+	ev.m_values[1] = v1;
+	ev.m_ints[0] = i0;
+	ev.m_ints[1] = i1;
+	ev.m_ext_call = extcall;
+	if (g_csurf_event_queue.push(ev) == false)
+		++g_csurf_events_dropped;
+}
+
+void MySurface::feedback(FeedbackParam param, MediaTrack* track, double value, int sub)
+{
+	// avoid the track id lookup when no feedback is being sent
+	if (m_feedback.isActive() == false)
+		return;
+	m_feedback.setValue(param, track != nullptr ? CSurf_TrackToID(track, false) : 0, sub, value);
+}
+
+void MySurface::setFeedbackTransport(std::unique_ptr<FeedbackTransport> transport)
+{
+	m_feedback.setTransport(std::move(transport));
+	if (m_feedback.isActive() == false)
+		return;
+	// REAPER only reports changes, the starting state comes from the mirror
+	auto& mixer = getMixerState();
+	for (int i = 0; i < mixer.getNumTracks(); ++i)
+	{
+		m_feedback.setValue(FeedbackParam::Volume, i + 1, 0, mixer.getVolume(i));
+		m_feedback.setValue(FeedbackParam::Pan, i + 1, 0, mixer.getPan(i));
+		m_feedback.setValue(FeedbackParam::Mute, i + 1, 0, mixer.hasFlag(i, MixerStateMirror::Mute));
+		m_feedback.setValue(FeedbackParam::Solo, i + 1, 0, mixer.hasFlag(i, MixerStateMirror::Solo));
+		m_feedback.setValue(FeedbackParam::Selected, i + 1, 0, mixer.hasFlag(i, MixerStateMirror::Selected));
+		m_feedback.setValue(FeedbackParam::RecArm, i + 1, 0, mixer.hasFlag(i, MixerStateMirror::RecArm));
+	}
+	m_feedback.setValue(FeedbackParam::PlayState, 0, 0, GetPlayState());
+}
+
+void MySurface::Run()
+{
+	m_feedback.run(Time::getMillisecondCounterHiRes());
+}
+
+void MySurface::SetTrackListChange()
+{
+	m_mixer_state.invalidateTrackList();
+	capture(CSurfEventType::TrackListChange, nullptr);
+}
+
+void MySurface::SetSurfaceVolume(MediaTrack* trackid, double volume)
+{
+	m_mixer_state.setVolume(trackid, volume);
+	feedback(FeedbackParam::Volume, trackid, volume);
+	capture(CSurfEventType::Volume, trackid, volume);
+}
+
+void MySurface::SetSurfacePan(MediaTrack* trackid, double pan)
+{
+	m_mixer_state.setPan(trackid, pan);
+	feedback(FeedbackParam::Pan, trackid, pan);
+	capture(CSurfEventType::Pan, trackid, pan);
+}
+
+void MySurface::SetSurfaceMute(MediaTrack* trackid, bool mute)
+{
+	m_mixer_state.setFlag(trackid, MixerStateMirror::Mute, mute);
+	feedback(FeedbackParam::Mute, trackid, mute);
+	capture(CSurfEventType::Mute, trackid, 0.0, 0.0, mute);
+}
+
+void MySurface::SetSurfaceSelected(MediaTrack* trackid, bool selected)
+{
+	m_mixer_state.setFlag(trackid, MixerStateMirror::Selected, selected);
+	feedback(FeedbackParam::Selected, trackid, selected);
+	capture(CSurfEventType::Selected, trackid, 0.0, 0.0, selected);
+}
+
+void MySurface::SetSurfaceSolo(MediaTrack* trackid, bool solo)
+{
+	m_mixer_state.setFlag(trackid, MixerStateMirror::Solo, solo);
+	feedback(FeedbackParam::Solo, trackid, solo);
+	capture(CSurfEventType::Solo, trackid, 0.0, 0.0, solo);
+}
+
+void MySurface::SetSurfaceRecArm(MediaTrack* trackid, bool recarm)
+{
+	m_mixer_state.setFlag(trackid, MixerStateMirror::RecArm, recarm);
+	feedback(FeedbackParam::RecArm, trackid, recarm);
+	capture(CSurfEventType::RecArm, trackid, 0.0, 0.0, recarm);
+}
+
+void MySurface::SetPlayState(bool play, bool pause, bool rec)
+{
+	feedback(FeedbackParam::PlayState, nullptr, (play ? 1 : 0) | (pause ? 2 : 0) | (rec ? 4 : 0));
+	capture(CSurfEventType::PlayState, nullptr, 0.0, 0.0, (play ? 1 : 0) | (pause ? 2 : 0) | (rec ? 4 : 0));
+}
+
+void MySurface::SetRepeatState(bool rep)
+{
+	feedback(FeedbackParam::RepeatState, nullptr, rep);
+	capture(CSurfEventType::RepeatState, nullptr, 0.0, 0.0, rep);
+}
+
+void MySurface::SetTrackTitle(MediaTrack* trackid, const char* title)
+{
+	InternedString name(title);
+	m_mixer_state.setTrackName(trackid, name);
+	// the id is only meaningful in this session, recordings replay the track's current name
+	capture(CSurfEventType::TrackTitle, trackid, 0.0, 0.0, (int)name.getId());
+}
+
+void MySurface::SetAutoMode(int mode)
+{
+	capture(CSurfEventType::AutoMode, nullptr, 0.0, 0.0, mode);
+}
+
+void MySurface::ResetCachedVolPanStates()
+{
+	m_feedback.resendAll();
+	capture(CSurfEventType::ResetCachedVolPanStates, nullptr);
+}
+
+void MySurface::OnTrackSelection(MediaTrack* trackid)
+{
+	capture(CSurfEventType::TrackSelection, trackid);
+}
+
+namespace
+{
+	int readInt(void* p)
+	{
+		return p != nullptr ? *(int*)p : -1;
+	}
+	double readDouble(void* p)
+	{
+		return p != nullptr ? *(double*)p : 0.0;
+	}
+}
+
+int MySurface::Extended(int call, void* parm1, void* parm2, void* parm3)
+{
+	const CSurfEventType ext = CSurfEventType::Extended;
+	switch (call)
+	{
+	case CSURF_EXT_SETFXPARAM:
+	{
+		int fxparam = readInt(parm2);
+		feedback(FeedbackParam::FXParam, (MediaTrack*)parm1, readDouble(parm3), fxparam);
+		capture(ext, (MediaTrack*)parm1, readDouble(parm3), 0.0, (fxparam >> 16) & 0xffff, fxparam & 0xffff, call);
+		break;
+	}
+	case CSURF_EXT_SETSENDVOLUME:
+	case CSURF_EXT_SETSENDPAN:
+	case CSURF_EXT_SETRECVVOLUME:
+	case CSURF_EXT_SETRECVPAN:
+		capture(ext, (MediaTrack*)parm1, readDouble(parm3), 0.0, readInt(parm2), 0, call);
+		break;
+	case CSURF_EXT_SETFXENABLED:
+	case CSURF_EXT_SETFXOPEN:
+		// parm3 is a plain flag here, not a pointer
+		capture(ext, (MediaTrack*)parm1, 0.0, 0.0, readInt(parm2), parm3 != nullptr, call);
+		break;
+	case CSURF_EXT_SETLASTTOUCHEDFX:
+	case CSURF_EXT_SETFOCUSEDFX:
+		capture(ext, (MediaTrack*)parm1, 0.0, 0.0, readInt(parm3), readInt(parm2), call);
+		break;
+	case CSURF_EXT_SETINPUTMONITOR:
+		capture(ext, (MediaTrack*)parm1, 0.0, 0.0, readInt(parm2), 0, call);
+		break;
+	case CSURF_EXT_SETFXCHANGE:
+		if (parm1 != nullptr)
+			m_mixer_state.invalidateFX((MediaTrack*)parm1);
+		else m_mixer_state.invalidateAllFX();
+		capture(ext, (MediaTrack*)parm1, 0.0, 0.0, 0, 0, call);
+		break;
+	case CSURF_EXT_SETLASTTOUCHEDTRACK:
+	case CSURF_EXT_SETMIXERSCROLL:
+		capture(ext, (MediaTrack*)parm1, 0.0, 0.0, 0, 0, call);
+		break;
+	case CSURF_EXT_SETPAN_EX:
+	{
+		int mode = readInt(parm3);
+		double* pan = (double*)parm2;
+		// stereo and dual pan modes pass two values
+		double second = (pan != nullptr && (mode == 5 || mode == 6)) ? pan[1] : 0.0;
+		capture(ext, (MediaTrack*)parm1, readDouble(parm2), second, mode, 0, call);
+		break;
+	}
+	case CSURF_EXT_SETBPMANDPLAYRATE:
+		capture(ext, nullptr, readDouble(parm1), readDouble(parm2), parm1 != nullptr, parm2 != nullptr, call);
+		break;
+	case CSURF_EXT_SETMETRONOME:
+	case CSURF_EXT_SETAUTORECARM:
+		capture(ext, nullptr, 0.0, 0.0, parm1 != nullptr, 0, call);
+		break;
+	case CSURF_EXT_SETRECMODE:
+		capture(ext, nullptr, 0.0, 0.0, readInt(parm1), 0, call);
+		break;
+	default:
+		// unknown calls are logged by code only, their parameters can't be interpreted safely
+		capture(ext, nullptr, 0.0, 0.0, 0, 0, call);
+		break;
+	}
+	return 0;
+}
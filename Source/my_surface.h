@@ -0,0 +1,49 @@
+#pragma once
+
+#include "reaper_plugin.h"
+#include "csurf_events.h"
+#include "mixer_state.h"
+#include "surface_feedback.h"
+
+// Control surface instance registered with "csurf_inst". It drives no hardware, it only
+// observes the state changes REAPER reports to surfaces, keeps the mixer state mirror up to
+// date from them and forwards them to the feedback engine.
+class MySurface : public IReaperControlSurface
+{
+public:
+	const char* GetTypeString() override;
+	const char* GetDescString() override;
+	const char* GetConfigString() override;
+
+	void Run() override;
+	void SetTrackListChange() override;
+	void SetSurfaceVolume(MediaTrack* trackid, double volume) override;
+	void SetSurfacePan(MediaTrack* trackid, double pan) override;
+	void SetSurfaceMute(MediaTrack* trackid, bool mute) override;
+	void SetSurfaceSelected(MediaTrack* trackid, bool selected) override;
+	void SetSurfaceSolo(MediaTrack* trackid, bool solo) override;
+	void SetSurfaceRecArm(MediaTrack* trackid, bool recarm) override;
+	void SetPlayState(bool play, bool pause, bool rec) override;
+	void SetRepeatState(bool rep) override;
+	void SetTrackTitle(MediaTrack* trackid, const char* title) override;
+	void SetAutoMode(int mode) override;
+	void ResetCachedVolPanStates() override;
+	void OnTrackSelection(MediaTrack* trackid) override;
+	int Extended(int call, void* parm1, void* parm2, void* parm3) override;
+	MixerStateMirror& getMixerState()
+	{
+		m_mixer_state.refreshIfNeeded();
+		return m_mixer_state;
+	}
+	SurfaceFeedbackEngine& getFeedbackEngine() { return m_feedback; }
+	// Sets the transport and queues the current state of all tracks for it
+	void setFeedbackTransport(std::unique_ptr<FeedbackTransport> transport);
+private:
+	MixerStateMirror m_mixer_state;
+	SurfaceFeedbackEngine m_feedback;
+	void feedback(FeedbackParam param, MediaTrack* track, double value, int sub = 0);
+	void capture(CSurfEventType type, MediaTrack* track, double v0 = 0.0, double v1 = 0.0, int i0 = 0, int i1 = 0, int extcall = 0);
+};
+
+// The instance registered by the plugin entry point
+extern MySurface* g_my_surface;
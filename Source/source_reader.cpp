@@ -0,0 +1,71 @@
+#include "source_reader.h"
+#include "reaper_plugin_functions.h"
+
+SourceReader::SourceReader(const String& filename)
+{
+	m_source = PCM_Source_CreateFromFile(filename.toRawUTF8());
+	if (m_source == nullptr)
+		return;
+	m_num_channels = m_source->GetNumChannels();
+	m_samplerate = m_source->GetSampleRate();
+	m_length = m_source->GetLength();
+	// sample rates below 1 mean MIDI or silence
+	if (m_num_channels < 1 || m_samplerate < 1.0)
+	{
+		delete m_source;
+		m_source = nullptr;
+		return;
+	}
+	m_end_frame = (int64)(m_length * m_samplerate);
+}
+
+SourceReader::~SourceReader()
+{
+	delete m_source;
+}
+
+void SourceReader::seek(double seconds)
+{
+	m_start_frame = (int64)(seconds * m_samplerate);
+	m_frames_read = 0;
+}
+
+int SourceReader::readNext(int numframes, std::vector<ReaSample>& buffer)
+{
+	numframes = (int)jmin<int64>(numframes, m_end_frame - (m_start_frame + m_frames_read));
+	if (numframes <= 0)
+		return 0;
+	if (buffer.size() < (size_t)numframes * m_num_channels)
+		buffer.resize((size_t)numframes * m_num_channels);
+	return readNext(numframes, buffer.data());
+}
+
+int SourceReader::readNext(int numframes, ReaSample* dest)
+{
+	if (m_source == nullptr)
+		return 0;
+	int64 pos = m_start_frame + m_frames_read;
+	numframes = (int)jmin<int64>(numframes, m_end_frame - pos);
+	if (numframes <= 0)
+		return 0;
+	PCM_source_transfer_t block;
+	memset(&block, 0, sizeof(block));
+	block.time_s = pos / m_samplerate;
+	block.samplerate = m_samplerate;
+	block.nch = m_num_channels;
+	block.length = numframes;
+	block.samples = dest;
+	m_source->GetSamples(&block);
+	m_frames_read += block.samples_out;
+	return block.samples_out;
+}
+
+String getTakeSourceFileName(MediaItem_Take* take)
+{
+	PCM_source* src = GetMediaItemTake_Source(take);
+	if (src == nullptr)
+		return String();
+	char buf[4096] = { 0 };
+	GetMediaSourceFileName(src, buf, 4096);
+	return String(CharPointer_UTF8(buf));
+}
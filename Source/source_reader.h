@@ -0,0 +1,40 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "reaper_plugin.h"
+
+// Reads a media file through REAPER's decoders as interleaved sample blocks. Every reader
+// creates its own PCM_source for the file, so readers on different threads share no decoder
+// state. Positions are kept in frames, so long sequential reads don't accumulate rounding.
+class SourceReader
+{
+public:
+	SourceReader(const String& filename);
+	~SourceReader();
+	SourceReader(const SourceReader&) = delete;
+	SourceReader& operator=(const SourceReader&) = delete;
+	bool isValid() const { return m_source != nullptr; }
+	int getNumChannels() const { return m_num_channels; }
+	double getSampleRate() const { return m_samplerate; }
+	double getLength() const { return m_length; }
+	// Next reads start from this time in seconds
+	void seek(double seconds);
+	// Reads up to numframes frames into buffer, which is resized as needed. Returns the number
+	// of frames read, 0 at the end of the source.
+	int readNext(int numframes, std::vector<ReaSample>& buffer);
+	// Same as above, into a caller provided buffer of numframes * getNumChannels() samples
+	int readNext(int numframes, ReaSample* dest);
+	// Reading stops at this time in seconds, instead of at the end of the file
+	void setEnd(double seconds) { m_end_frame = (int64)(seconds * m_samplerate); }
+private:
+	PCM_source* m_source = nullptr;
+	int m_num_channels = 0;
+	double m_samplerate = 0.0;
+	double m_length = 0.0;
+	int64 m_start_frame = 0;
+	int64 m_frames_read = 0;
+	int64 m_end_frame = 0;
+};
+
+// Returns the file name of a take's source, empty for MIDI and other non file sources
+String getTakeSourceFileName(MediaItem_Take* take);
@@ -0,0 +1,199 @@
+#include "surface_feedback.h"
+#include "reaper_plugin_functions.h"
+
+namespace
+{
+	const int maxdatagramsize = 1400;
+	void writeOSCString(MemoryOutputStream& os, const String& txt)
+	{
+		os.write(txt.toRawUTF8(), txt.getNumBytesAsUTF8());
+		// null terminated and padded to 4 bytes
+		int pad = 4 - (int)(txt.getNumBytesAsUTF8() % 4);
+		for (int i = 0; i < pad; ++i)
+			os.writeByte(0);
+	}
+}
+
+OSCFeedbackTransport::OSCFeedbackTransport(String host, int port) : m_host(host), m_port(port)
+{
+}
+
+String OSCFeedbackTransport::getAddress(const FeedbackMessage& msg)
+{
+	String track = "/track/" + String(msg.m_track);
+	switch (msg.m_param)
+	{
+	case FeedbackParam::Volume: return track + "/volume";
+	case FeedbackParam::Pan: return track + "/pan";
+	case FeedbackParam::Mute: return track + "/mute";
+	case FeedbackParam::Solo: return track + "/solo";
+	case FeedbackParam::Selected: return track + "/select";
+	case FeedbackParam::RecArm: return track + "/recarm";
+	case FeedbackParam::FXParam: return track + "/fx/" + String(msg.m_sub >> 16) + "/param/" + String(msg.m_sub & 0xffff);
+	case FeedbackParam::PlayState: return "/playstate";
+	case FeedbackParam::RepeatState: return "/repeat";
+	default: return "/unknown";
+	}
+}
+
+void OSCFeedbackTransport::flushPacket()
+{
+	if (m_packet_messages > 0)
+		m_socket.write(m_host, m_port, m_packet.getData(), (int)m_packet.getDataSize());
+	m_packet.reset();
+	m_packet_messages = 0;
+}
+
+void OSCFeedbackTransport::sendBundle(const std::vector<FeedbackMessage>& messages)
+{
+	MemoryOutputStream message;
+	for (auto& msg : messages)
+	{
+		message.reset();
+		writeOSCString(message, getAddress(msg));
+		writeOSCString(message, ",f");
+		message.writeFloatBigEndian((float)msg.m_value);
+		int elementsize = 4 + (int)message.getDataSize();
+		if (m_packet_messages > 0 && (int)m_packet.getDataSize() + elementsize > maxdatagramsize)
+			flushPacket();
+		if (m_packet_messages == 0)
+		{
+			writeOSCString(m_packet, "#bundle");
+			// time tag 1 means "immediately"
+			m_packet.writeInt64BigEndian(1);
+		}
+		m_packet.writeIntBigEndian((int)message.getDataSize());
+		m_packet.write(message.getData(), message.getDataSize());
+		++m_packet_messages;
+	}
+	flushPacket();
+}
+
+MIDIFeedbackTransport::MIDIFeedbackTransport(std::unique_ptr<MidiOutput> output) : m_output(std::move(output))
+{
+}
+
+void MIDIFeedbackTransport::sendBundle(const std::vector<FeedbackMessage>& messages)
+{
+	m_buffer.clear();
+	int pos = 0;
+	for (auto& msg : messages)
+	{
+		if (msg.m_param == FeedbackParam::PlayState)
+		{
+			m_buffer.addEvent(MidiMessage::noteOn(1, 94, (uint8)(((int)msg.m_value & 1) != 0 ? 127 : 0)), pos++);
+			continue;
+		}
+		if (msg.m_param == FeedbackParam::RepeatState)
+		{
+			m_buffer.addEvent(MidiMessage::noteOn(1, 86, (uint8)(msg.m_value != 0.0 ? 127 : 0)), pos++);
+			continue;
+		}
+		if (msg.m_track < 1 || msg.m_track > 16)
+			continue;
+		int chan = msg.m_track;
+		uint8 onoff = msg.m_value != 0.0 ? 127 : 0;
+		switch (msg.m_param)
+		{
+		case FeedbackParam::Volume:
+			// REAPER's own fader law, 1000 is +12 dB
+			m_buffer.addEvent(MidiMessage::pitchWheel(chan, jlimit(0, 16383, (int)(DB2SLIDER(Decibels::gainToDecibels(msg.m_value, -150.0)) / 1000.0 * 16383.0))), pos++);
+			break;
+		case FeedbackParam::Pan:
+			m_buffer.addEvent(MidiMessage::controllerEvent(chan, 10, jlimit(0, 127, roundToInt((msg.m_value + 1.0) * 63.5))), pos++);
+			break;
+		case FeedbackParam::RecArm:
+			m_buffer.addEvent(MidiMessage::noteOn(chan, 0, onoff), pos++);
+			break;
+		case FeedbackParam::Solo:
+			m_buffer.addEvent(MidiMessage::noteOn(chan, 1, onoff), pos++);
+			break;
+		case FeedbackParam::Mute:
+			m_buffer.addEvent(MidiMessage::noteOn(chan, 2, onoff), pos++);
+			break;
+		case FeedbackParam::Selected:
+			m_buffer.addEvent(MidiMessage::noteOn(chan, 3, onoff), pos++);
+			break;
+		default:
+			break;
+		}
+	}
+	if (m_buffer.isEmpty() == false)
+		m_output->sendBlockOfMessagesNow(m_buffer);
+}
+
+void SurfaceFeedbackEngine::setTransport(std::unique_ptr<FeedbackTransport> transport)
+{
+	m_transport = std::move(transport);
+	// a new destination knows nothing yet
+	resendAll();
+}
+
+void SurfaceFeedbackEngine::setValue(FeedbackParam param, int track, int sub, double value)
+{
+	if (m_transport == nullptr || track < 0)
+		return;
+	++m_num_received;
+	uint64 key = makeKey(param, track & 0xffffff, sub);
+	Entry& e = m_state[key];
+	e.m_value = value;
+	if (e.m_pending == false)
+	{
+		e.m_pending = true;
+		m_pending.push_back(key);
+	}
+}
+
+void SurfaceFeedbackEngine::resendAll()
+{
+	m_pending.clear();
+	for (auto& e : m_state)
+	{
+		e.second.m_was_sent = false;
+		e.second.m_pending = true;
+		m_pending.push_back(e.first);
+	}
+}
+
+void SurfaceFeedbackEngine::run(double nowms)
+{
+	if (m_transport == nullptr || m_pending.empty() == true || nowms - m_last_flush_ms < m_interval_ms)
+		return;
+	m_last_flush_ms = nowms;
+	flush();
+}
+
+void SurfaceFeedbackEngine::flush()
+{
+	if (m_transport == nullptr)
+		return;
+	m_bundle.clear();
+	for (uint64 key : m_pending)
+	{
+		Entry& e = m_state[key];
+		e.m_pending = false;
+		// the value may have gone back to what the hardware already shows
+		if (e.m_was_sent == true && e.m_sent == e.m_value)
+			continue;
+		e.m_sent = e.m_value;
+		e.m_was_sent = true;
+		FeedbackMessage msg;
+		msg.m_param = (FeedbackParam)(key >> 56);
+		msg.m_track = (int)((key >> 32) & 0xffffff);
+		msg.m_sub = (int)(uint32)key;
+		msg.m_value = e.m_value;
+		m_bundle.push_back(msg);
+		if ((int)m_bundle.size() == m_bundle_size)
+		{
+			m_transport->sendBundle(m_bundle);
+			m_num_sent += m_bundle.size();
+			m_bundle.clear();
+		}
+	}
+	m_pending.clear();
+	if (m_bundle.empty() == false)
+	{
+		m_transport->sendBundle(m_bundle);
+		m_num_sent += m_bundle.size();
+	}
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include <unordered_map>
+
+enum class FeedbackParam : uint8
+{
+	Volume,
+	Pan,
+	Mute,
+	Solo,
+	Selected,
+	RecArm,
+	FXParam,
+	PlayState,
+	RepeatState,
+	NumParams
+};
+
+// One value to send to the hardware. m_track is the CSurf_TrackToID number, 0 is the master
+// track. m_sub is (fx index << 16 | parameter index) for FX parameters, 0 otherwise.
+struct FeedbackMessage
+{
+	FeedbackParam m_param = FeedbackParam::Volume;
+	int m_track = 0;
+	int m_sub = 0;
+	double m_value = 0.0;
+};
+
+class FeedbackTransport
+{
+public:
+	virtual ~FeedbackTransport() {}
+	virtual String getName() const = 0;
+	// Called on the main thread with at most the engine's bundle size of messages
+	virtual void sendBundle(const std::vector<FeedbackMessage>& messages) = 0;
+};
+
+// OSC over UDP, each bundle goes out as OSC bundles that fit into one datagram.
+// Addresses are like /track/3/volume and /track/3/fx/1/param/4, values are floats.
+class OSCFeedbackTransport : public FeedbackTransport
+{
+public:
+	OSCFeedbackTransport(String host, int port);
+	String getName() const override { return "OSC " + m_host + ":" + String(m_port); }
+	void sendBundle(const std::vector<FeedbackMessage>& messages) override;
+	static String getAddress(const FeedbackMessage& msg);
+private:
+	void flushPacket();
+	DatagramSocket m_socket;
+	String m_host;
+	int m_port = 0;
+	MemoryOutputStream m_packet;
+	int m_packet_messages = 0;
+};
+
+// MIDI for the first 16 tracks, each on its own channel : volume as pitch bend, pan as CC 10 and
+// the switches as notes 0-3 (rec arm, solo, mute, select). Play and repeat use the Mackie notes
+// 94 and 86 on channel 1. The master track and FX parameters are not sent.
+class MIDIFeedbackTransport : public FeedbackTransport
+{
+public:
+	MIDIFeedbackTransport(std::unique_ptr<MidiOutput> output);
+	String getName() const override { return "MIDI " + m_output->getName(); }
+	void sendBundle(const std::vector<FeedbackMessage>& messages) override;
+private:
+	std::unique_ptr<MidiOutput> m_output;
+	MidiBuffer m_buffer;
+};
+
+// Keeps what would have been sent, for tests and for inspecting the feedback without hardware
+class LoopbackFeedbackTransport : public FeedbackTransport
+{
+public:
+	String getName() const override { return "Loopback"; }
+	void sendBundle(const std::vector<FeedbackMessage>& messages) override
+	{
+		m_bundles.push_back(messages);
+	}
+	std::vector<std::vector<FeedbackMessage>> m_bundles;
+};
+
+// Collects the state changes reported by the surface callbacks and sends only the values that
+// differ from what the hardware was last sent. Changes between two flushes coalesce, so a
+// fader moved 100 times between flushes produces one message. All calls are on the main thread.
+class SurfaceFeedbackEngine
+{
+public:
+	void setTransport(std::unique_ptr<FeedbackTransport> transport);
+	FeedbackTransport* getTransport() const { return m_transport.get(); }
+	bool isActive() const { return m_transport != nullptr; }
+	void setRate(double hz) { m_interval_ms = 1000.0 / jlimit(1.0, 100.0, hz); }
+	double getRate() const { return 1000.0 / m_interval_ms; }
+	void setBundleSize(int maxmessages) { m_bundle_size = jmax(1, maxmessages); }
+	void setValue(FeedbackParam param, int track, int sub, double value);
+	// Forgets what was sent, so the next flush sends the complete known state
+	void resendAll();
+	// Called from the surface's Run(), flushes when the interval has elapsed
+	void run(double nowms);
+	void flush();
+	int64 getNumReceived() const { return m_num_received; }
+	int64 getNumSent() const { return m_num_sent; }
+private:
+	struct Entry
+	{
+		double m_value = 0.0;
+		double m_sent = 0.0;
+		bool m_was_sent = false;
+		bool m_pending = false;
+	};
+	static uint64 makeKey(FeedbackParam param, int track, int sub)
+	{
+		return ((uint64)param << 56) | ((uint64)(uint32)track << 32) | (uint32)sub;
+	}
+	std::unique_ptr<FeedbackTransport> m_transport;
+	std::unordered_map<uint64, Entry> m_state;
+	std::vector<uint64> m_pending;
+	std::vector<FeedbackMessage> m_bundle;
+	double m_interval_ms = 1000.0 / 30.0;
+	double m_last_flush_ms = 0.0;
+	int m_bundle_size = 64;
+	int64 m_num_received = 0;
+	int64 m_num_sent = 0;
+};
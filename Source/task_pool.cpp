@@ -0,0 +1,271 @@
+#include "task_pool.h"
+
+#if JUCE_WINDOWS
+#include <windows.h>
+#elif JUCE_LINUX
+#include <sched.h>
+#endif
+
+namespace
+{
+	thread_local TaskPool* t_worker_pool = nullptr;
+	thread_local int t_worker_index = -1;
+}
+
+TaskGroup::TaskGroup(TaskPool& pool, String name, TaskPriority prio) : m_pool(pool), m_name(name), m_priority(prio)
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+	cancel();
+	wait();
+}
+
+void TaskGroup::add(std::function<void(void)> task)
+{
+	++m_pending;
+	m_pool.submit({ std::move(task), this, Time::getMillisecondCounterHiRes() });
+}
+
+bool TaskGroup::wait(int timeoutms)
+{
+	const double endtime = Time::getMillisecondCounterHiRes() + timeoutms;
+	while (true)
+	{
+		{
+			// taskDone finishes with the mutex, so once we see 0 here nothing touches the group anymore
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_pending.load() == 0)
+				return true;
+		}
+		if (timeoutms >= 0 && Time::getMillisecondCounterHiRes() >= endtime)
+			return false;
+		if (m_pool.runOneTask(this) == false)
+		{
+			// the remaining tasks are running on the workers
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_cv.wait_for(lock, std::chrono::milliseconds(1), [this]() { return m_pending.load() == 0; });
+		}
+	}
+}
+
+void TaskGroup::taskDone()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (--m_pending == 0)
+		m_cv.notify_all();
+}
+
+class TaskPool::Worker : public Thread
+{
+public:
+	Worker(TaskPool& pool, int index) : Thread("Task pool worker " + String(index)), m_pool(pool), m_index(index) {}
+	void run() override
+	{
+		t_worker_pool = &m_pool;
+		t_worker_index = m_index;
+		m_pool.workerLoop(m_index);
+	}
+private:
+	TaskPool& m_pool;
+	int m_index = 0;
+};
+
+TaskPool::TaskPool(int numworkers)
+{
+	numworkers = jmax(1, numworkers);
+	for (int i = 0; i < numworkers + 1; ++i)
+		m_queues.push_back(std::make_unique<WorkQueue>());
+	for (int i = 0; i < numworkers; ++i)
+	{
+		m_workers.add(new Worker(*this, i));
+		m_workers.getLast()->startThread();
+	}
+}
+
+TaskPool::~TaskPool()
+{
+	shutdown();
+}
+
+int TaskPool::getDefaultNumWorkers()
+{
+	int numcpus = SystemStats::getNumCpus();
+#if JUCE_WINDOWS
+	DWORD_PTR processmask = 0;
+	DWORD_PTR systemmask = 0;
+	if (GetProcessAffinityMask(GetCurrentProcess(), &processmask, &systemmask) != 0 && processmask != 0)
+	{
+		numcpus = 0;
+		for (; processmask != 0; processmask &= processmask - 1)
+			++numcpus;
+	}
+#elif JUCE_LINUX
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	if (sched_getaffinity(0, sizeof(cpus), &cpus) == 0)
+		numcpus = CPU_COUNT(&cpus);
+#endif
+	return jmax(1, numcpus - 1);
+}
+
+std::map<String, TaskPool::TaskStats> TaskPool::getStats() const
+{
+	const SpinLock::ScopedLockType locker(m_stats_lock);
+	return m_stats;
+}
+
+void TaskPool::shutdown()
+{
+	for (auto w : m_workers)
+		w->signalThreadShouldExit();
+	{
+		std::lock_guard<std::mutex> lock(m_sleep_mutex);
+		m_sleep_cv.notify_all();
+	}
+	for (auto w : m_workers)
+		w->stopThread(-1);
+	m_workers.clear();
+	// nobody will run these anymore, their groups still need to hear they are done
+	for (auto& q : m_queues)
+	{
+		std::lock_guard<std::mutex> lock(q->m_mutex);
+		for (auto& deq : q->m_tasks)
+		{
+			for (auto& task : deq)
+				task.m_group->taskDone();
+			deq.clear();
+		}
+	}
+	m_num_queued = 0;
+}
+
+int TaskPool::getCurrentWorkerIndex() const
+{
+	return t_worker_pool == this ? t_worker_index : -1;
+}
+
+void TaskPool::submit(Task task)
+{
+	int index = getCurrentWorkerIndex();
+	if (index < 0)
+		index = (int)m_queues.size() - 1;
+	{
+		auto& q = *m_queues[index];
+		std::lock_guard<std::mutex> lock(q.m_mutex);
+		q.m_tasks[(int)task.m_group->getPriority()].push_back(std::move(task));
+	}
+	++m_num_queued;
+	std::lock_guard<std::mutex> lock(m_sleep_mutex);
+	m_sleep_cv.notify_one();
+}
+
+bool TaskPool::popTask(int workerindex, TaskGroup* onlygroup, Task& task)
+{
+	const int numqueues = (int)m_queues.size();
+	const int sharedindex = numqueues - 1;
+	for (int prio = 0; prio < (int)TaskPriority::NumPriorities; ++prio)
+	{
+		if (onlygroup != nullptr && (int)onlygroup->getPriority() != prio)
+			continue;
+		// own deque from the back while its tasks are still warm in the cache, then the shared deque,
+		// then the front of the other workers' deques
+		for (int i = 0; i < numqueues; ++i)
+		{
+			int index = 0;
+			if (workerindex < 0)
+				index = (sharedindex + i) % numqueues;
+			else if (i == 0)
+				index = workerindex;
+			else if (i == 1)
+				index = sharedindex;
+			else
+			{
+				index = (workerindex + i - 1) % sharedindex;
+				if (index == workerindex)
+					continue;
+			}
+			auto& q = *m_queues[index];
+			std::lock_guard<std::mutex> lock(q.m_mutex);
+			auto& deq = q.m_tasks[prio];
+			if (deq.empty())
+				continue;
+			if (onlygroup != nullptr)
+			{
+				auto it = std::find_if(deq.begin(), deq.end(), [onlygroup](const Task& t) { return t.m_group == onlygroup; });
+				if (it == deq.end())
+					continue;
+				task = std::move(*it);
+				deq.erase(it);
+			}
+			else if (index == workerindex)
+			{
+				task = std::move(deq.back());
+				deq.pop_back();
+			}
+			else
+			{
+				task = std::move(deq.front());
+				deq.pop_front();
+			}
+			--m_num_queued;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool TaskPool::runOneTask(TaskGroup* onlygroup)
+{
+	Task task;
+	if (popTask(getCurrentWorkerIndex(), onlygroup, task) == false)
+		return false;
+	execute(task);
+	return true;
+}
+
+void TaskPool::execute(Task& task)
+{
+	TaskGroup* group = task.m_group;
+	const double t0 = Time::getMillisecondCounterHiRes();
+	const bool skip = group->isCancelled();
+	if (skip == false)
+		task.m_func();
+	const double t1 = Time::getMillisecondCounterHiRes();
+	{
+		const SpinLock::ScopedLockType locker(m_stats_lock);
+		auto& stats = m_stats[group->getName()];
+		if (skip == true)
+			++stats.m_skipped;
+		else
+		{
+			++stats.m_count;
+			stats.m_total_run += t1 - t0;
+			stats.m_max_run = jmax(stats.m_max_run, t1 - t0);
+			stats.m_total_wait += t0 - task.m_queued_time;
+		}
+	}
+	// the closure may hold resources that should go before the group knows it is done
+	task.m_func = nullptr;
+	group->taskDone();
+}
+
+void TaskPool::workerLoop(int workerindex)
+{
+	Thread* thread = Thread::getCurrentThread();
+	while (thread->threadShouldExit() == false)
+	{
+		Task task;
+		if (popTask(workerindex, nullptr, task) == true)
+		{
+			execute(task);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(m_sleep_mutex);
+		m_sleep_cv.wait_for(lock, std::chrono::milliseconds(50), [this, thread]()
+		{
+			return m_num_queued.load() > 0 || thread->threadShouldExit();
+		});
+	}
+}
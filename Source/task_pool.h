@@ -0,0 +1,108 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include <deque>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+
+enum class TaskPriority
+{
+	Interactive, // something the user is waiting for right now
+	Batch,
+	NumPriorities
+};
+
+class TaskPool;
+
+// Tasks that belong together, like the items of one scan or render. The group is the unit of
+// cancellation : tasks of a cancelled group that have not started are skipped, and running tasks
+// are expected to poll isCancelled. Destroying the group cancels it and waits for its running tasks.
+class TaskGroup
+{
+public:
+	TaskGroup(TaskPool& pool, String name, TaskPriority prio);
+	~TaskGroup();
+	TaskGroup(const TaskGroup&) = delete;
+	TaskGroup& operator=(const TaskGroup&) = delete;
+	void add(std::function<void(void)> task);
+	void cancel() { m_cancelled = true; }
+	bool isCancelled() const { return m_cancelled.load(); }
+	int getNumPending() const { return m_pending.load(); }
+	// Runs tasks of this group on the calling thread while waiting, so waiting from inside a pool
+	// task can't deadlock. Returns false on timeout.
+	bool wait(int timeoutms = -1);
+	const String& getName() const { return m_name; }
+	TaskPriority getPriority() const { return m_priority; }
+	TaskPool& getPool() { return m_pool; }
+private:
+	friend class TaskPool;
+	void taskDone();
+	TaskPool& m_pool;
+	String m_name;
+	TaskPriority m_priority = TaskPriority::Batch;
+	std::atomic<bool> m_cancelled{ false };
+	std::atomic<int> m_pending{ 0 };
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+};
+
+// Work stealing thread pool shared by the whole extension. Each worker has its own deques, one per
+// priority. Tasks added from a worker go to the back of its own deque and are popped from there,
+// tasks added from other threads go to a shared deque, and idle workers steal from the front of
+// the other deques. Interactive tasks are always taken before batch tasks.
+class TaskPool
+{
+public:
+	struct TaskStats
+	{
+		int64 m_count = 0;
+		int64 m_skipped = 0;
+		// milliseconds
+		double m_total_run = 0.0;
+		double m_max_run = 0.0;
+		double m_total_wait = 0.0;
+	};
+	explicit TaskPool(int numworkers);
+	~TaskPool();
+	// CPUs the process is allowed to run on, less one that is left for REAPER's audio and UI threads
+	static int getDefaultNumWorkers();
+	int getNumThreads() const { return m_workers.size(); }
+	int getNumQueued() const { return m_num_queued.load(); }
+	// per task group name
+	std::map<String, TaskStats> getStats() const;
+	// Stops the workers once their current tasks return. Tasks still queued are skipped.
+	void shutdown();
+private:
+	friend class TaskGroup;
+	struct Task
+	{
+		std::function<void(void)> m_func;
+		TaskGroup* m_group = nullptr;
+		double m_queued_time = 0.0;
+	};
+	struct WorkQueue
+	{
+		std::mutex m_mutex;
+		std::deque<Task> m_tasks[(int)TaskPriority::NumPriorities];
+	};
+	class Worker;
+	void submit(Task task);
+	// onlygroup limits the search to the tasks of one group
+	bool runOneTask(TaskGroup* onlygroup);
+	bool popTask(int workerindex, TaskGroup* onlygroup, Task& task);
+	void execute(Task& task);
+	void workerLoop(int workerindex);
+	int getCurrentWorkerIndex() const;
+	// one per worker, the last one takes the tasks added from outside the pool
+	std::vector<std::unique_ptr<WorkQueue>> m_queues;
+	OwnedArray<Worker> m_workers;
+	std::atomic<int> m_num_queued{ 0 };
+	std::mutex m_sleep_mutex;
+	std::condition_variable m_sleep_cv;
+	mutable SpinLock m_stats_lock;
+	std::map<String, TaskStats> m_stats;
+};
+
+// Owned by the plugin, created in the entry point and destroyed in the unload branch
+extern std::unique_ptr<TaskPool> g_task_pool;
@@ -0,0 +1,270 @@
+#include "time_stretch.h"
+#include "source_reader.h"
+#include "reaper_plugin_functions.h"
+
+namespace
+{
+	struct PitchShiftDeleter
+	{
+		void operator()(IReaperPitchShift* ps) const { delete ps; }
+	};
+	// created on first use by each pool worker, destroyed when the worker ends at unload
+	thread_local std::unique_ptr<IReaperPitchShift, PitchShiftDeleter> t_pitch_shifter;
+
+	void writeToSink(PCM_sink* sink, ReaSample* interleaved, int numframes, int nch)
+	{
+		ReaSample* channels[64];
+		for (int c = 0; c < nch; ++c)
+			channels[c] = interleaved + c;
+		sink->WriteDoubles(channels, numframes, nch, 0, nch);
+	}
+}
+
+bool renderTimeStretchItem(TimeStretchItem& item, const TimeStretchParams& params, std::function<bool(double)> progress)
+{
+	SourceReader reader(item.m_source_file);
+	if (reader.isValid() == false)
+		return false;
+	const int nch = jmin(reader.getNumChannels(), 64);
+	const double srate = reader.getSampleRate();
+	if (t_pitch_shifter == nullptr)
+		t_pitch_shifter.reset(ReaperGetPitchShiftAPI(REAPER_PITCHSHIFT_API_VER));
+	IReaperPitchShift* ps = t_pitch_shifter.get();
+	if (ps == nullptr)
+		return false;
+	ps->Reset();
+	ps->set_srate(srate);
+	ps->set_nch(nch);
+	ps->set_tempo(params.m_rate);
+	ps->set_shift(std::pow(2.0, params.m_semitones / 12.0));
+	ps->SetQualityParameter(-1);
+	// 24 bit WAV
+	const char cfg[] = { 'e', 'v', 'a', 'w', 24, 0 };
+	std::unique_ptr<PCM_sink> sink(PCM_Sink_Create(item.m_out_file.getFullPathName().toRawUTF8(), cfg, sizeof(cfg), nch, (int)srate, true));
+	if (sink == nullptr)
+		return false;
+	reader.seek(item.m_source_start);
+	reader.setEnd(item.m_source_start + item.m_source_length);
+	const int blocksize = 8192;
+	std::vector<ReaSample> inbuf((size_t)blocksize * reader.getNumChannels());
+	std::vector<ReaSample> outbuf((size_t)blocksize * nch);
+	int64 framesin = 0;
+	int64 framesout = 0;
+	auto drain = [&]()
+	{
+		for (;;)
+		{
+			int got = ps->GetSamples(blocksize, outbuf.data());
+			if (got <= 0)
+				break;
+			writeToSink(sink.get(), outbuf.data(), got, nch);
+			framesout += got;
+		}
+	};
+	for (;;)
+	{
+		int got = reader.readNext(blocksize, inbuf.data());
+		if (got <= 0)
+			break;
+		ReaSample* dest = ps->GetBuffer(got);
+		if (nch == reader.getNumChannels())
+			memcpy(dest, inbuf.data(), sizeof(ReaSample) * got * nch);
+		else for (int i = 0; i < got; ++i)
+			memcpy(dest + i * nch, inbuf.data() + (size_t)i * reader.getNumChannels(), sizeof(ReaSample) * nch);
+		ps->BufferDone(got);
+		framesin += got;
+		drain();
+		if (progress && progress(framesin / (item.m_source_length * srate)) == false)
+			return false;
+	}
+	ps->FlushSamples();
+	drain();
+	item.m_out_length = framesout / srate;
+	return framesout > 0;
+}
+
+TimeStretchRenderer::TimeStretchRenderer(std::vector<TimeStretchItem> items, TimeStretchParams params) :
+	m_items(std::move(items)), m_params(params), m_tasks(*g_task_pool, "Time stretch render", TaskPriority::Interactive)
+{
+}
+
+TimeStretchRenderer::~TimeStretchRenderer()
+{
+	m_tasks.cancel();
+	m_tasks.wait();
+	// the names were reserved up front, so closing the window mid-render would leave empty or partial files behind
+	for (auto& item : m_items)
+		if (item.m_committed == false)
+			item.m_out_file.deleteFile();
+}
+
+std::vector<TimeStretchItem> TimeStretchRenderer::collectSelectedItems()
+{
+	std::vector<TimeStretchItem> result;
+	char buf[4096];
+	GetProjectPathEx(nullptr, buf, 4096);
+	File folder(CharPointer_UTF8(buf));
+	folder.createDirectory();
+	for (int i = 0; i < CountSelectedMediaItems(nullptr); ++i)
+	{
+		MediaItem* item = GetSelectedMediaItem(nullptr, i);
+		MediaItem_Take* take = GetActiveTake(item);
+		if (take == nullptr)
+			continue;
+		TimeStretchItem tsitem;
+		tsitem.m_source_file = getTakeSourceFileName(take);
+		if (tsitem.m_source_file.isEmpty())
+			continue;
+		tsitem.m_item = item;
+		tsitem.m_name = String(CharPointer_UTF8(GetTakeName(take)));
+		double playrate = *(double*)GetSetMediaItemTakeInfo(take, "D_PLAYRATE", nullptr);
+		tsitem.m_source_start = *(double*)GetSetMediaItemTakeInfo(take, "D_STARTOFFS", nullptr);
+		tsitem.m_source_length = *(double*)GetSetMediaItemInfo(item, "D_LENGTH", nullptr) * playrate;
+		// take names are not paths, they may contain slashes and are not absolute
+		String basename = tsitem.m_name.upToLastOccurrenceOf(".", false, false);
+		tsitem.m_out_file = folder.getChildFile(File::createLegalFileName(basename + "_stretched.wav"))
+			.getNonexistentSibling();
+		// reserve the name, so items with the same take name get different files
+		tsitem.m_out_file.create();
+		result.push_back(tsitem);
+	}
+	return result;
+}
+
+void TimeStretchRenderer::start()
+{
+	m_start_time = Time::getMillisecondCounterHiRes();
+	for (auto& item : m_items)
+	{
+		TimeStretchItem* it = &item;
+		m_tasks.add([this, it]()
+		{
+			it->m_ok = renderTimeStretchItem(*it, m_params, [this](double) { return m_tasks.isCancelled() == false; });
+			if (++m_num_done == (int)m_items.size())
+				postFinish();
+		});
+	}
+	if (m_items.empty() == true)
+		postFinish();
+}
+
+double TimeStretchRenderer::getSpeed() const
+{
+	double end = m_end_time > 0.0 ? m_end_time : Time::getMillisecondCounterHiRes();
+	double total = 0.0;
+	for (auto& item : m_items)
+		total += item.m_source_length;
+	return total / jmax(0.001, (end - m_start_time) / 1000.0);
+}
+
+void TimeStretchRenderer::postFinish()
+{
+	m_finish_pending = m_main_thread.post([this]() { finish(); }) == false;
+}
+
+void TimeStretchRenderer::retryFinish()
+{
+	if (m_finish_pending.exchange(false) == true)
+		postFinish();
+}
+
+void TimeStretchRenderer::finish()
+{
+	m_end_time = Time::getMillisecondCounterHiRes();
+	commitResults();
+	if (OnFinished)
+		OnFinished();
+}
+
+void TimeStretchRenderer::commitResults()
+{
+	PreventUIRefresh(1);
+	for (auto& item : m_items)
+	{
+		if (item.m_ok == false || ValidatePtr(item.m_item, "MediaItem*") == false)
+		{
+			item.m_out_file.deleteFile();
+			continue;
+		}
+		PCM_source* src = PCM_Source_CreateFromFile(item.m_out_file.getFullPathName().toRawUTF8());
+		if (src == nullptr)
+			continue;
+		MediaItem_Take* take = AddTakeToMediaItem(item.m_item);
+		SetMediaItemTake_Source(take, src);
+		GetSetMediaItemTakeInfo_String(take, "P_NAME", (char*)item.m_out_file.getFileName().toRawUTF8(), true);
+		SetActiveTake(take);
+		SetMediaItemInfo_Value(item.m_item, "D_LENGTH", item.m_out_length);
+		item.m_committed = true;
+	}
+	PreventUIRefresh(-1);
+	UpdateArrange();
+	Undo_OnStateChange("Time stretch : render items");
+}
+
+TimeStretchComponent::TimeStretchComponent()
+{
+	addAndMakeVisible(&m_rate_slider);
+	m_rate_slider.setRange(0.25, 4.0, 0.01);
+	m_rate_slider.setSkewFactorFromMidPoint(1.0);
+	m_rate_slider.setValue(1.0);
+	m_rate_slider.setTooltip("Playback rate");
+	addAndMakeVisible(&m_pitch_slider);
+	m_pitch_slider.setRange(-24.0, 24.0, 0.01);
+	m_pitch_slider.setValue(0.0);
+	m_pitch_slider.setTooltip("Pitch shift (semitones)");
+	addAndMakeVisible(&m_render_button);
+	m_render_button.setButtonText("Render selected items");
+	m_render_button.setTooltip("Render the selected items into new files and add them as new takes");
+	m_render_button.addListener(this);
+	addAndMakeVisible(&m_status_label);
+	setSize(300, 110); // need some initial size, so Juce does not assert
+}
+
+void TimeStretchComponent::resized()
+{
+	m_rate_slider.setBounds(1, 1, getWidth() - 2, 24);
+	m_pitch_slider.setBounds(1, 26, getWidth() - 2, 24);
+	m_render_button.setBounds(1, 51, 150, 24);
+	m_status_label.setBounds(1, 76, getWidth() - 2, 24);
+}
+
+void TimeStretchComponent::buttonClicked(Button* but)
+{
+	if (but != &m_render_button || m_renderer != nullptr)
+		return;
+	auto items = TimeStretchRenderer::collectSelectedItems();
+	if (items.empty() == true)
+	{
+		m_status_label.setText("No audio items selected", dontSendNotification);
+		return;
+	}
+	TimeStretchParams params;
+	params.m_rate = m_rate_slider.getValue();
+	params.m_semitones = m_pitch_slider.getValue();
+	m_renderer = std::make_unique<TimeStretchRenderer>(std::move(items), params);
+	m_renderer->OnFinished = [this]()
+	{
+		stopTimer();
+		m_status_label.setText(String(m_renderer->getNumItems()) + " items rendered, " + String(m_renderer->getSpeed(), 1) + "x realtime",
+			dontSendNotification);
+		m_render_button.setEnabled(true);
+		// can't destroy the renderer from inside its own callback
+		Component::SafePointer<TimeStretchComponent> safethis(this);
+		MessageManager::callAsync([safethis]()
+		{
+			if (safethis != nullptr)
+				safethis->m_renderer = nullptr;
+		});
+	};
+	m_render_button.setEnabled(false);
+	m_renderer->start();
+	startTimer(100);
+}
+
+void TimeStretchComponent::timerCallback()
+{
+	if (m_renderer == nullptr)
+		return;
+	m_renderer->retryFinish();
+	m_status_label.setText("Rendering " + String(m_renderer->getNumDone()) + "/" + String(m_renderer->getNumItems()), dontSendNotification);
+}
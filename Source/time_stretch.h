@@ -0,0 +1,75 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "reaper_plugin.h"
+#include "task_pool.h"
+#include "main_thread_tasks.h"
+
+struct TimeStretchItem
+{
+	MediaItem* m_item = nullptr;
+	String m_name;
+	String m_source_file;
+	double m_source_start = 0.0;
+	double m_source_length = 0.0;
+	File m_out_file;
+	bool m_ok = false;
+	double m_out_length = 0.0;
+	bool m_committed = false; // the file is used by a take, it must be kept
+};
+
+struct TimeStretchParams
+{
+	double m_rate = 1.0; // playback rate, 2.0 renders half as long
+	double m_semitones = 0.0;
+};
+
+// Renders one item's source through an IReaperPitchShift into a new file. Each thread keeps
+// its own pitch shifter instance and reuses it for the items it renders.
+bool renderTimeStretchItem(TimeStretchItem& item, const TimeStretchParams& params, std::function<bool(double)> progress);
+
+// Renders items in parallel on the shared task pool. The last render to finish posts the commit to
+// the main thread, which adds the new files as active takes of their items in one undo step.
+class TimeStretchRenderer
+{
+public:
+	TimeStretchRenderer(std::vector<TimeStretchItem> items, TimeStretchParams params);
+	~TimeStretchRenderer();
+	static std::vector<TimeStretchItem> collectSelectedItems();
+	void start();
+	int getNumItems() const { return (int)m_items.size(); }
+	int getNumDone() const { return m_num_done.load(); }
+	// seconds of source rendered per second of wall clock time
+	double getSpeed() const;
+	// Posts the finish again if the main thread task queue was full when the last item was done.
+	// Called from the owner's timer.
+	void retryFinish();
+	std::function<void(void)> OnFinished;
+private:
+	void postFinish();
+	void finish();
+	void commitResults();
+	std::vector<TimeStretchItem> m_items;
+	TimeStretchParams m_params;
+	std::atomic<int> m_num_done{ 0 };
+	double m_start_time = 0.0;
+	double m_end_time = 0.0;
+	std::atomic<bool> m_finish_pending{ false };
+	MainThreadTaskToken m_main_thread;
+	TaskGroup m_tasks;
+};
+
+class TimeStretchComponent : public Component, public Button::Listener, private Timer
+{
+public:
+	TimeStretchComponent();
+	void resized() override;
+	void buttonClicked(Button* but) override;
+private:
+	void timerCallback() override;
+	Slider m_rate_slider;
+	Slider m_pitch_slider;
+	TextButton m_render_button;
+	Label m_status_label;
+	std::unique_ptr<TimeStretchRenderer> m_renderer;
+};
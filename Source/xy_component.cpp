@@ -1,5 +1,6 @@
 #include "xy_component.h"
 #include "reaper_plugin_functions.h"
+#include "my_surface.h"
 
 XYComponent::XYComponent() :
 	m_x_skew_slider(Slider::LinearHorizontal, Slider::TextBoxRight),
@@ -19,17 +20,13 @@ void XYComponent::timerCallback(int id)
 	{
 		if (m_xymode == XYMode::Constant)
 			return;
-		if (m_path.isEmpty() == false && m_path_finished == true)
+		if (m_tempo_locked == true)
+			g_xy_tempo_cache.update();
+		double normpos = 0.0;
+		if (m_path_snapshot != nullptr && m_path_snapshot->isEmpty() == false &&
+			m_transport.getPathPosition(*m_path_snapshot, Time::getMillisecondCounterHiRes(), normpos) == true)
 		{
-			double pdur = m_path_duration;
-			double playpos = fmod(Time::getMillisecondCounterHiRes() - m_tpos, pdur);
-			double pathposnorm = 1.0 / pdur*playpos;
-			if (m_timewarp >= 0.0)
-				pathposnorm = pow(pathposnorm, 1.0 + 4.0*m_timewarp);
-			else
-				pathposnorm = 1.0 - pow(1.0 - pathposnorm, 1.0 + 4.0*-m_timewarp);
-			double pathpos = m_path.getLength() * pathposnorm;
-			auto pt = m_path.getPointAlongPath(pathpos);
+			auto pt = m_path_snapshot->getPointAt(normpos);
 			updateFXParams(pt.x, 1.0 - pt.y);
 			m_x_pos = pt.x;
 			m_y_pos = pt.y;
@@ -43,6 +40,7 @@ void XYComponent::timerCallback(int id)
 			m_path.closeSubPath();
 		repaint();
 		m_tpos = Time::getMillisecondCounterHiRes();
+		updatePathSnapshot();
 		stopTimer(20001);
 	}
 }
@@ -75,6 +73,7 @@ void XYComponent::mouseDown(const MouseEvent & ev)
 		stopTimer(20001);
 		m_path.startNewSubPath(1.0 / getWidth()*ev.x, 1.0 / getHeight()*ev.y);
 		m_path_finished = false;
+		updatePathSnapshot();
 		repaint();
 	}
 	if (ev.mods.isRightButtonDown() == true)
@@ -90,6 +89,7 @@ void XYComponent::mouseDrag(const MouseEvent & ev)
 	if (m_xymode == XYMode::Path)
 		m_path.lineTo(m_x_pos, m_y_pos);
 	updateFXParams(m_x_pos, 1.0 - m_y_pos);
+	m_midi_sender.setPosition(m_x_pos, 1.0 - m_y_pos);
 	repaint();
 }
 
@@ -125,11 +125,30 @@ void XYComponent::mouseUp(const MouseEvent & ev)
 void XYComponent::setPathDuration(double len)
 {
 	m_path_duration = jlimit<double>(0.1,120000.0,len);
+	updatePathSnapshot();
+}
+
+void XYComponent::setPathDurationBeats(double beats)
+{
+	m_path_beats = jlimit<double>(0.1, 1024.0, beats);
+	updatePathSnapshot();
 }
 
 void XYComponent::setTimeWarp(double w)
 {
 	m_timewarp = jlimit<double>(-1.0, 1.0, w);
+	updatePathSnapshot();
+}
+
+void XYComponent::updatePathSnapshot()
+{
+	// the MIDI output thread keeps using the old snapshot until it sees the new one
+	if (m_path_finished == true && m_xymode == XYMode::Path && m_path.isEmpty() == false)
+		m_path_snapshot = std::make_shared<XYPathSnapshot>(m_path, m_path_duration, m_tpos, m_timewarp,
+			m_tempo_locked ? m_path_beats : 0.0);
+	else
+		m_path_snapshot = nullptr;
+	m_midi_sender.setPath(m_path_snapshot);
 }
 
 void XYComponent::showOptionsMenu()
@@ -137,6 +156,8 @@ void XYComponent::showOptionsMenu()
 	PopupMenu menu;
 	menu.addItem(7, "Choose parameters...");
 	menu.addItem(8, "Auto-close path", true, m_auto_close_path);
+	menu.addItem(9, "MIDI output...", true, m_midi_sender.isActive());
+	menu.addItem(10, "Lock path to project tempo and play position", true, m_tempo_locked);
 	PopupMenu modemenu;
 	modemenu.addItem(100, "Constant", true, m_xymode == XYMode::Constant);
 	modemenu.addItem(101, "Path", true, m_xymode == XYMode::Path);
@@ -149,18 +170,16 @@ void XYComponent::showOptionsMenu()
 	int fx = -1;
 	int par = -1;
 	GetLastTouchedFX(&tk, &fx, &par);
-	if (tk >= 1 && fx >= 0)
+	auto& mixer = g_my_surface->getMixerState();
+	if (tk >= 1 && fx >= 0 && tk - 1 < mixer.getNumTracks())
 	{
-		MediaTrack* track = GetTrack(nullptr, tk - 1);
-		if (track != nullptr)
+		// names from the mirror, shared with the parameter chooser
+		auto& fxlist = mixer.getFX(tk - 1);
+		if (fx < (int)fxlist.size())
 		{
-			char buf1[2048];
-			char buf2[2048];
-			if (TrackFX_GetFXName(track, fx, buf1, 2048) == true &&
-				TrackFX_GetParamName(track, fx, par, buf2, 2048) == true)
+			if (par >= 0 && par < (int)fxlist[fx].m_param_names.size())
 			{
-
-				String fxparname = String(CharPointer_UTF8(buf1)) + " : " + String(CharPointer_UTF8(buf2));
+				String fxparname = fxlist[fx].m_name.get() + " : " + fxlist[fx].m_param_names[par].get();
 				menu.addItem(1, "Assign " + fxparname + " to X axis");
 				menu.addItem(2, "Assign " + fxparname + " to Y axis");
 				menu.addItem(3, "Remove X assignment");
@@ -190,6 +209,7 @@ void XYComponent::showOptionsMenu()
 	{
 		m_path.clear();
 		m_path_finished = false;
+		updatePathSnapshot();
 		repaint();
 	}
 	if (r == 7)
@@ -213,10 +233,23 @@ void XYComponent::showOptionsMenu()
 	{
 		m_auto_close_path = !m_auto_close_path;
 	}
+	if (r == 9)
+	{
+		auto comp = new XYMidiSettingsComponent(m_midi_sender);
+		CallOutBox::launchAsynchronously(comp, { 0,0,10,10 }, this);
+	}
+	if (r == 10)
+	{
+		m_tempo_locked = !m_tempo_locked;
+		if (m_tempo_locked == true)
+			g_xy_tempo_cache.update();
+		updatePathSnapshot();
+	}
 	if (r == 100)
 	{
 		m_xymode = XYMode::Constant;
 		m_path.clear();
+		updatePathSnapshot();
 	}
 	if (r == 101)
 		m_xymode = XYMode::Path;
@@ -245,7 +278,7 @@ void ParameterTreeItem::paintItem(Graphics & g, int w, int h)
 	else
 		g.fillAll(Colours::Colours::white);
 	g.setColour(Colours::black);
-	g.drawText(m_txt, 0, 0, w, h, Justification::left);
+	g.drawText(m_txt.get(), 0, 0, w, h, Justification::left);
 }
 
 void ParameterTreeItem::itemClicked(const MouseEvent & e)
@@ -283,7 +316,26 @@ ParameterChooserComponent::ParameterChooserComponent()
 
 ParameterChooserComponent::~ParameterChooserComponent()
 {
-	m_tv.deleteRootItem();
+	releaseTree();
+}
+
+void ParameterChooserComponent::releaseTree()
+{
+	if (m_root_item == nullptr)
+		return;
+	m_tv.setRootItem(nullptr);
+	// TreeViewItem deletes its sub items, so they are detached before the arena destroys them
+	std::function<void(TreeViewItem*)> detach = [&detach](TreeViewItem* item)
+	{
+		for (int i = item->getNumSubItems(); --i >= 0;)
+		{
+			detach(item->getSubItem(i));
+			item->removeSubItem(i, false);
+		}
+	};
+	detach(m_root_item);
+	m_root_item = nullptr;
+	m_item_arena.reset();
 }
 
 void ParameterChooserComponent::resized()
@@ -298,61 +350,61 @@ void ParameterChooserComponent::textEditorTextChanged(TextEditor & ed)
 		updateTree(m_filter_edit.getText());
 }
 
-bool containsAllTokens(const String& txt, const StringArray& filtertokens)
+// every token has to be in at least one of the names, the tokens are already in lowercase
+bool containsAllTokens(InternedString txt0, InternedString txt1, InternedString txt2, const StringArray& filtertokens)
 {
-	int cnt = 0;
 	for (int i = 0; i < filtertokens.size(); ++i)
 	{
-		if (txt.containsIgnoreCase(filtertokens[i]) == true)
-			++cnt;
+		const String& token = filtertokens[i];
+		if (txt0.getLowerCase().contains(token) == false && txt1.getLowerCase().contains(token) == false &&
+			txt2.getLowerCase().contains(token) == false)
+			return false;
 	}
-	return cnt == filtertokens.size();
+	return true;
 }
 
 void ParameterChooserComponent::updateTree(String filter)
 {
-	StringArray filtertokens = StringArray::fromTokens(filter, " ");
-	m_tv.deleteRootItem();
-	ParameterTreeItem* rootitem = new ParameterTreeItem(this, "Root", -1, -1, -1, false);
-	for (int i = 0; i < CountTracks(nullptr); ++i)
+	StringArray filtertokens = StringArray::fromTokens(filter.toLowerCase(), " ");
+	releaseTree();
+	ParameterTreeItem* rootitem = m_item_arena.create<ParameterTreeItem>(this, InternedString("Root"), -1, -1, -1, false);
+	// names come from the mirror kept by the control surface, no API calls per parameter
+	auto& mixer = g_my_surface->getMixerState();
+	for (int i = 0; i < mixer.getNumTracks(); ++i)
 	{
-		MediaTrack* track = GetTrack(nullptr, i);
-		char buf[4096];
-		GetSetMediaTrackInfo_String(track, "P_NAME", buf, false);
-		String trackname = String(CharPointer_UTF8(buf));
+		InternedString trackname = mixer.getTrackNameHandle(i);
 		if (trackname.isEmpty())
-			trackname = String(i + 1);
+			trackname = InternedString(String(i + 1));
 		ParameterTreeItem* trackitem = nullptr;  
-		for (int j = 0; j < TrackFX_GetCount(track); ++j)
+		auto& fxlist = mixer.getFX(i);
+		for (int j = 0; j < (int)fxlist.size(); ++j)
 		{
-			TrackFX_GetFXName(track, j, buf, 4096);
-			String fxname = String(CharPointer_UTF8(buf));
+			InternedString fxname = fxlist[j].m_name;
 			ParameterTreeItem* fxitem = nullptr;  
-			for (int k = 0; k < TrackFX_GetNumParams(track, j); ++k)
+			for (int k = 0; k < (int)fxlist[j].m_param_names.size(); ++k)
 			{
-				TrackFX_GetParamName(track, j, k, buf, 4096);
-				String parname = String(CharPointer_UTF8(buf));
-				String pathtopar = trackname + fxname + parname;
-				if (containsAllTokens(pathtopar, filtertokens) == true)
+				InternedString parname = fxlist[j].m_param_names[k];
+				if (containsAllTokens(trackname, fxname, parname, filtertokens) == true)
 				{
 					if (trackitem == nullptr)
 					{
-						trackitem = new ParameterTreeItem(this, trackname, i, -1, -1, false);
+						trackitem = m_item_arena.create<ParameterTreeItem>(this, trackname, i, -1, -1, false);
 						rootitem->addSubItem(trackitem, -1);
 						trackitem->setOpen(true);
 					}
 					if (fxitem == nullptr)
 					{
-						fxitem = new ParameterTreeItem(this, fxname, i, j, -1, false);
+						fxitem = m_item_arena.create<ParameterTreeItem>(this, fxname, i, j, -1, false);
 						trackitem->addSubItem(fxitem, -1);
 						fxitem->setOpen(true);
 					}
-					ParameterTreeItem* paramitem = new ParameterTreeItem(this, parname, i, j, k, true);
+					ParameterTreeItem* paramitem = m_item_arena.create<ParameterTreeItem>(this, parname, i, j, k, true);
 					fxitem->addSubItem(paramitem, -1);
 				}
 			}
 		}
 	}
+	m_root_item = rootitem;
 	m_tv.setRootItem(rootitem);
 	m_tv.setRootItemVisible(false);
 }
@@ -435,7 +487,7 @@ XYComponentWithSliders::XYComponentWithSliders() :
 	m_slid_pathdur.setSkewFactor(0.3);
 	m_slid_pathdur.setValue(5.0);
 	m_slid_pathdur.addListener(this);
-	m_slid_pathdur.setTooltip("Path duration (seconds)");
+	m_slid_pathdur.setTooltip("Path duration (seconds, or beats when locked to the project tempo)");
 	addAndMakeVisible(m_slid_timewarp);
 	m_slid_timewarp.setRange(-1.0, 1.0);
 	m_slid_timewarp.setValue(0.0);
@@ -448,7 +500,10 @@ XYComponentWithSliders::XYComponentWithSliders() :
 void XYComponentWithSliders::sliderValueChanged(Slider * slid)
 {
 	if (slid == &m_slid_pathdur)
+	{
 		m_xycomp->setPathDuration(slid->getValue()*1000.0);
+		m_xycomp->setPathDurationBeats(slid->getValue());
+	}
 	if (slid == &m_slid_timewarp)
 		m_xycomp->setTimeWarp(slid->getValue());
 }
@@ -1,24 +1,17 @@
 #pragma once
 
 #include "JuceHeader.h"
-
-class PointWithTime
-{
-public:
-	PointWithTime() {}
-	PointWithTime(double tpos, double x, double y)
-		: m_time(tpos), m_x(x), m_y(y) {}
-	double m_time = 0.0;
-	double m_x = 0.0;
-	double m_y = 0.0;
-};
+#include "xy_path.h"
+#include "xy_midi_output.h"
+#include "xy_transport.h"
+#include "arena.h"
 
 class ParameterChooserComponent;
 
 class ParameterTreeItem : public TreeViewItem
 {
 public:
-	ParameterTreeItem(ParameterChooserComponent* chooser, String txt, int trackid, int fxid, int paramid, bool isleaf) :
+	ParameterTreeItem(ParameterChooserComponent* chooser, InternedString txt, int trackid, int fxid, int paramid, bool isleaf) :
 		m_txt(txt), m_isleaf(isleaf), m_chooser(chooser), m_track_index(trackid),
 		m_fx_index(fxid), m_param_index(paramid)
 	{}
@@ -31,7 +24,7 @@ public:
 	String getNodeType()
 	{
 		if (m_isleaf == true)
-			return m_txt;
+			return m_txt.get();
 		return String();
 	}
 	ParameterChooserComponent* m_chooser = nullptr;
@@ -39,7 +32,7 @@ public:
 	int m_fx_index = -1;
 	int m_param_index = -1;
 private:
-	String m_txt;
+	InternedString m_txt;
 	bool m_isleaf = false;
 	
 };
@@ -55,7 +48,11 @@ public:
 private:
 	TreeView m_tv;
 	TextEditor m_filter_edit;
+	// the tree items of the current filter result, all freed together when the filter changes
+	Arena m_item_arena;
+	ParameterTreeItem* m_root_item = nullptr;
 	void updateTree(String filter);
+	void releaseTree();
 };
 
 enum class XYMode
@@ -90,10 +87,12 @@ public:
 	void updateFXParams(double x, double y);
 	void mouseUp(const MouseEvent& ev) override;
 	void setPathDuration(double len);
+	void setPathDurationBeats(double beats);
 	void setTimeWarp(double w);
 	void showOptionsMenu();
 	void sliderValueChanged(Slider* slid) override;
 private:
+	void updatePathSnapshot();
 	double m_x_pos = 0.5;
 	double m_y_pos = 0.5;
 	FXAssignment m_x_assignment;
@@ -103,10 +102,15 @@ private:
 	bool m_auto_close_path = true;
 	double m_path_duration = 5000.0;
 	double m_timewarp = 0.0;
+	bool m_tempo_locked = false;
+	double m_path_beats = 5.0;
+	XYTransportFollower m_transport;
 	XYMode m_xymode = XYMode::Path;
 	Slider m_x_skew_slider;
 	Slider m_y_skew_slider;
 	Path m_path;
+	std::shared_ptr<const XYPathSnapshot> m_path_snapshot;
+	XYMidiSender m_midi_sender;
 };
 
 class XYComponentWithSliders : public Component, public Slider::Listener
@@ -0,0 +1,276 @@
+#include "xy_midi_output.h"
+#include "reaper_plugin_functions.h"
+
+XYMidiSender::XYMidiSender() : m_thread(XYMidiOutputThread::getShared())
+{
+	m_thread->addSender(this);
+}
+
+XYMidiSender::~XYMidiSender()
+{
+	m_thread->removeSender(this);
+}
+
+void XYMidiSender::setAssignment(int axis, XYMidiAssignment assignment)
+{
+	// before taking our lock, the output thread holds its own lock while it calls process
+	if (assignment.m_type != XYMidiMessageType::None)
+		m_thread->openOutput(assignment.m_destination);
+	const ScopedLock locker(m_cs);
+	m_axes[axis] = AxisState();
+	m_axes[axis].m_assignment = assignment;
+}
+
+XYMidiAssignment XYMidiSender::getAssignment(int axis)
+{
+	const ScopedLock locker(m_cs);
+	return m_axes[axis].m_assignment;
+}
+
+bool XYMidiSender::isActive()
+{
+	const ScopedLock locker(m_cs);
+	return m_axes[0].m_assignment.m_type != XYMidiMessageType::None ||
+		m_axes[1].m_assignment.m_type != XYMidiMessageType::None;
+}
+
+void XYMidiSender::setPosition(double x, double y)
+{
+	const ScopedLock locker(m_cs);
+	m_pos[0] = x;
+	m_pos[1] = y;
+}
+
+void XYMidiSender::setPath(std::shared_ptr<const XYPathSnapshot> path)
+{
+	const ScopedLock locker(m_cs);
+	m_path = path;
+}
+
+void XYMidiSender::process(XYMidiOutputThread& thread, double nowms)
+{
+	const ScopedLock locker(m_cs);
+	if (m_axes[0].m_assignment.m_type == XYMidiMessageType::None &&
+		m_axes[1].m_assignment.m_type == XYMidiMessageType::None)
+		return;
+	double normpos = 0.0;
+	if (m_path != nullptr && m_path->isEmpty() == false && m_transport.getPathPosition(*m_path, nowms, normpos) == true)
+	{
+		auto pt = m_path->getPointAt(normpos);
+		m_pos[0] = pt.x;
+		m_pos[1] = 1.0 - pt.y;
+	}
+	for (int i = 0; i < 2; ++i)
+		if (m_axes[i].m_assignment.m_type != XYMidiMessageType::None)
+			thread.sendAxis(m_axes[i], m_pos[i], nowms);
+}
+
+std::shared_ptr<XYMidiOutputThread> XYMidiOutputThread::getShared()
+{
+	// only used from the message thread
+	static std::weak_ptr<XYMidiOutputThread> s_instance;
+	auto result = s_instance.lock();
+	if (result == nullptr)
+	{
+		result = std::shared_ptr<XYMidiOutputThread>(new XYMidiOutputThread);
+		s_instance = result;
+		result->startThread(9);
+	}
+	return result;
+}
+
+XYMidiOutputThread::XYMidiOutputThread() : Thread("XY MIDI output")
+{
+}
+
+XYMidiOutputThread::~XYMidiOutputThread()
+{
+	stopThread(1000);
+}
+
+void XYMidiOutputThread::addSender(XYMidiSender* sender)
+{
+	const ScopedLock locker(m_cs);
+	m_senders.addIfNotAlreadyThere(sender);
+}
+
+void XYMidiOutputThread::removeSender(XYMidiSender* sender)
+{
+	const ScopedLock locker(m_cs);
+	m_senders.removeFirstMatchingValue(sender);
+}
+
+void XYMidiOutputThread::openOutput(int destination)
+{
+	if (destination < 0)
+		return;
+	{
+		const ScopedLock locker(m_cs);
+		if (m_outputs.count(destination) > 0)
+			return;
+	}
+	// opening a device can take a while, the timing thread keeps running meanwhile
+	std::unique_ptr<midi_Output> output(CreateMIDIOutput(destination, false, nullptr));
+	const ScopedLock locker(m_cs);
+	m_outputs.emplace(destination, std::move(output));
+}
+
+void XYMidiOutputThread::run()
+{
+	while (threadShouldExit() == false)
+	{
+		const double now = Time::getMillisecondCounterHiRes();
+		{
+			const ScopedLock locker(m_cs);
+			for (auto sender : m_senders)
+				sender->process(*this, now);
+		}
+		wait(1);
+	}
+}
+
+void XYMidiOutputThread::sendAxis(XYMidiSender::AxisState& axis, double value, double nowms)
+{
+	const XYMidiAssignment& a = axis.m_assignment;
+	const int q = roundToInt(jlimit(0.0, 1.0, value) * a.getMaxValue());
+	if (q == axis.m_last_sent)
+		return;
+	// a skipped value is not lost, the next tick sends whatever the position is by then
+	if (nowms - axis.m_last_send_time < m_min_interval)
+		return;
+	const int cc = 0xb0 | a.m_channel;
+	const int msb = q >> 7;
+	const int lsb = q & 127;
+	switch (a.m_type)
+	{
+	case XYMidiMessageType::CC:
+		send(a.m_destination, cc, a.m_number & 127, q);
+		break;
+	case XYMidiMessageType::CC14:
+		// receivers clear the LSB when the MSB arrives, so the MSB goes first and only when it changed
+		if (axis.m_last_sent < 0 || (axis.m_last_sent >> 7) != msb)
+			send(a.m_destination, cc, a.m_number & 31, msb);
+		send(a.m_destination, cc, (a.m_number & 31) + 32, lsb);
+		break;
+	case XYMidiMessageType::NRPN:
+	{
+		int& selected = m_selected_nrpns.emplace(std::make_pair(a.m_destination, a.m_channel), -1).first->second;
+		if (selected != a.m_number)
+		{
+			send(a.m_destination, cc, 99, (a.m_number >> 7) & 127);
+			send(a.m_destination, cc, 98, a.m_number & 127);
+			selected = a.m_number;
+		}
+		send(a.m_destination, cc, 6, msb);
+		send(a.m_destination, cc, 38, lsb);
+		break;
+	}
+	case XYMidiMessageType::PitchBend:
+		send(a.m_destination, 0xe0 | a.m_channel, lsb, msb);
+		break;
+	default:
+		return;
+	}
+	axis.m_last_sent = q;
+	axis.m_last_send_time = nowms;
+}
+
+void XYMidiOutputThread::send(int destination, int status, int d1, int d2)
+{
+	if (destination < 0)
+	{
+		StuffMIDIMessage(0, status, d1, d2);
+		return;
+	}
+	auto it = m_outputs.find(destination);
+	if (it != m_outputs.end() && it->second != nullptr)
+		it->second->Send((unsigned char)status, (unsigned char)d1, (unsigned char)d2, -1);
+}
+
+XYMidiSettingsComponent::XYMidiSettingsComponent(XYMidiSender& sender) : m_sender(sender)
+{
+	for (int i = 0; i < 2; ++i)
+	{
+		auto& ctrls = m_axis_controls[i];
+		auto assignment = m_sender.getAssignment(i);
+		addAndMakeVisible(&ctrls.m_label);
+		ctrls.m_label.setText(i == 0 ? "X axis" : "Y axis", dontSendNotification);
+		addAndMakeVisible(&ctrls.m_type_combo);
+		ctrls.m_type_combo.addItemList({ "None", "CC", "14 bit CC", "NRPN", "Pitch bend" }, 1);
+		ctrls.m_type_combo.setSelectedId((int)assignment.m_type + 1, dontSendNotification);
+		ctrls.m_type_combo.addListener(this);
+		addAndMakeVisible(&ctrls.m_dest_combo);
+		ctrls.m_dest_combo.addItem("Virtual MIDI keyboard", 1);
+		for (int j = 0; j < GetNumMIDIOutputs(); ++j)
+		{
+			char buf[512];
+			if (GetMIDIOutputName(j, buf, 512) == true)
+				ctrls.m_dest_combo.addItem(CharPointer_UTF8(buf), j + 2);
+		}
+		ctrls.m_dest_combo.setSelectedId(assignment.m_destination + 2, dontSendNotification);
+		ctrls.m_dest_combo.addListener(this);
+		addAndMakeVisible(&ctrls.m_channel_slider);
+		ctrls.m_channel_slider.setRange(1.0, 16.0, 1.0);
+		ctrls.m_channel_slider.setValue(assignment.m_channel + 1, dontSendNotification);
+		ctrls.m_channel_slider.setTooltip("MIDI channel");
+		ctrls.m_channel_slider.addListener(this);
+		addAndMakeVisible(&ctrls.m_number_slider);
+		ctrls.m_number_slider.setRange(0.0, 16383.0, 1.0);
+		ctrls.m_number_slider.setSkewFactorFromMidPoint(127.0);
+		ctrls.m_number_slider.setValue(assignment.m_number, dontSendNotification);
+		ctrls.m_number_slider.setTooltip("Controller number (0-31 for 14 bit CCs) or NRPN number");
+		ctrls.m_number_slider.addListener(this);
+	}
+	addAndMakeVisible(&m_interval_slider);
+	m_interval_slider.setRange(0.0, 100.0, 1.0);
+	m_interval_slider.setValue(m_sender.getThread().getMinInterval(), dontSendNotification);
+	m_interval_slider.setTextValueSuffix(" ms");
+	m_interval_slider.setTooltip("Minimum time between messages of an axis");
+	m_interval_slider.addListener(this);
+	setSize(300, 290);
+}
+
+void XYMidiSettingsComponent::resized()
+{
+	int y = 1;
+	for (auto& ctrls : m_axis_controls)
+	{
+		ctrls.m_label.setBounds(1, y, getWidth() - 2, 20);
+		ctrls.m_type_combo.setBounds(1, y + 21, getWidth() - 2, 24);
+		ctrls.m_dest_combo.setBounds(1, y + 46, getWidth() - 2, 24);
+		ctrls.m_channel_slider.setBounds(1, y + 71, getWidth() - 2, 24);
+		ctrls.m_number_slider.setBounds(1, y + 96, getWidth() - 2, 24);
+		y += 125;
+	}
+	m_interval_slider.setBounds(1, y + 10, getWidth() - 2, 24);
+}
+
+void XYMidiSettingsComponent::comboBoxChanged(ComboBox* combo)
+{
+	for (int i = 0; i < 2; ++i)
+		if (combo == &m_axis_controls[i].m_type_combo || combo == &m_axis_controls[i].m_dest_combo)
+			updateAssignment(i);
+}
+
+void XYMidiSettingsComponent::sliderValueChanged(Slider* slid)
+{
+	if (slid == &m_interval_slider)
+	{
+		m_sender.getThread().setMinInterval(slid->getValue());
+		return;
+	}
+	for (int i = 0; i < 2; ++i)
+		if (slid == &m_axis_controls[i].m_channel_slider || slid == &m_axis_controls[i].m_number_slider)
+			updateAssignment(i);
+}
+
+void XYMidiSettingsComponent::updateAssignment(int axis)
+{
+	auto& ctrls = m_axis_controls[axis];
+	XYMidiAssignment assignment;
+	assignment.m_type = (XYMidiMessageType)jmax(0, ctrls.m_type_combo.getSelectedId() - 1);
+	assignment.m_destination = jmax(1, ctrls.m_dest_combo.getSelectedId()) - 2;
+	assignment.m_channel = (int)ctrls.m_channel_slider.getValue() - 1;
+	assignment.m_number = (int)ctrls.m_number_slider.getValue();
+	m_sender.setAssignment(axis, assignment);
+}
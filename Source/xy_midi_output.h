@@ -0,0 +1,110 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "reaper_plugin.h"
+#include "xy_path.h"
+#include "xy_transport.h"
+#include <map>
+
+enum class XYMidiMessageType
+{
+	None,
+	CC,
+	CC14,
+	NRPN,
+	PitchBend
+};
+
+struct XYMidiAssignment
+{
+	XYMidiMessageType m_type = XYMidiMessageType::None;
+	int m_channel = 0; // 0..15
+	int m_number = 1; // controller number, 0..31 for 14 bit CCs, 0..16383 for NRPNs
+	int m_destination = -1; // -1 for REAPER's virtual MIDI keyboard, otherwise a REAPER MIDI output device index
+	int getMaxValue() const { return m_type == XYMidiMessageType::CC ? 127 : 16383; }
+};
+
+class XYMidiOutputThread;
+
+// MIDI output of one XY pad. The GUI thread sets the assignments, the dragged position and the
+// finished path, the output thread evaluates the path on its own clock and sends the changed values.
+class XYMidiSender
+{
+public:
+	XYMidiSender();
+	~XYMidiSender();
+	void setAssignment(int axis, XYMidiAssignment assignment);
+	XYMidiAssignment getAssignment(int axis);
+	bool isActive();
+	// y goes up, like the FX parameters
+	void setPosition(double x, double y);
+	// nullptr stops the path playback
+	void setPath(std::shared_ptr<const XYPathSnapshot> path);
+	XYMidiOutputThread& getThread() { return *m_thread; }
+private:
+	friend class XYMidiOutputThread;
+	struct AxisState
+	{
+		XYMidiAssignment m_assignment;
+		int m_last_sent = -1;
+		double m_last_send_time = 0.0;
+	};
+	void process(XYMidiOutputThread& thread, double nowms);
+	CriticalSection m_cs;
+	AxisState m_axes[2];
+	double m_pos[2] = { 0.5, 0.5 };
+	std::shared_ptr<const XYPathSnapshot> m_path;
+	XYTransportFollower m_transport;
+	std::shared_ptr<XYMidiOutputThread> m_thread;
+};
+
+// Sends the MIDI of all XY pads from a 1 ms tick, independent of the GUI timers. Values are
+// deduplicated after quantizing to the message resolution and rate limited per axis.
+class XYMidiOutputThread : public Thread
+{
+public:
+	// the thread runs as long as some XY pad holds a reference to it
+	static std::shared_ptr<XYMidiOutputThread> getShared();
+	~XYMidiOutputThread();
+	void addSender(XYMidiSender* sender);
+	void removeSender(XYMidiSender* sender);
+	// message thread only, the timing thread sends to the outputs opened here and never opens any itself
+	void openOutput(int destination);
+	void setMinInterval(double ms) { m_min_interval = jlimit(0.0, 1000.0, ms); }
+	double getMinInterval() const { return m_min_interval; }
+	void run() override;
+private:
+	XYMidiOutputThread();
+	friend class XYMidiSender;
+	void sendAxis(XYMidiSender::AxisState& axis, double value, double nowms);
+	void send(int destination, int status, int d1, int d2);
+	CriticalSection m_cs;
+	Array<XYMidiSender*> m_senders;
+	// opened by openOutput, nullptr entries for devices that failed to open
+	std::map<int, std::unique_ptr<midi_Output>> m_outputs;
+	// receivers keep one selected NRPN per channel, shared by all axes sending there. Keyed by (destination, channel).
+	std::map<std::pair<int, int>, int> m_selected_nrpns;
+	std::atomic<double> m_min_interval{ 4.0 };
+};
+
+class XYMidiSettingsComponent : public Component, public ComboBox::Listener, public Slider::Listener
+{
+public:
+	XYMidiSettingsComponent(XYMidiSender& sender);
+	void resized() override;
+	void comboBoxChanged(ComboBox* combo) override;
+	void sliderValueChanged(Slider* slid) override;
+private:
+	struct AxisControls
+	{
+		Label m_label;
+		ComboBox m_type_combo;
+		ComboBox m_dest_combo;
+		Slider m_channel_slider;
+		Slider m_number_slider;
+	};
+	void updateAssignment(int axis);
+	XYMidiSender& m_sender;
+	AxisControls m_axis_controls[2];
+	Slider m_interval_slider;
+};
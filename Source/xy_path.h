@@ -0,0 +1,91 @@
+#pragma once
+
+#include "JuceHeader.h"
+
+class PointWithTime
+{
+public:
+	PointWithTime() {}
+	PointWithTime(double tpos, double x, double y)
+		: m_time(tpos), m_x(x), m_y(y) {}
+	double m_time = 0.0;
+	double m_x = 0.0;
+	double m_y = 0.0;
+};
+
+// Immutable flattened copy of an XY path with its playback timing, so the path can be evaluated
+// from threads other than the GUI thread. m_time of the points is the normalized distance along the path.
+class XYPathSnapshot
+{
+public:
+	// a nonzero beats value locks the path to the project, one cycle then lasts that many quarter notes
+	XYPathSnapshot(const Path& path, double duration, double starttime, double timewarp, double beats = 0.0) :
+		m_duration(duration), m_start_time(starttime), m_timewarp(timewarp), m_beats(beats)
+	{
+		// the path is in 0..1 coordinates, so the default flattening tolerance would be far too coarse
+		PathFlatteningIterator it(path, AffineTransform(), 0.001f);
+		double len = 0.0;
+		int subpath = -1;
+		while (it.next())
+		{
+			if (it.subPathIndex != subpath)
+			{
+				m_points.emplace_back(len, it.x1, it.y1);
+				subpath = it.subPathIndex;
+			}
+			len += Point<double>(it.x1, it.y1).getDistanceFrom(Point<double>(it.x2, it.y2));
+			m_points.emplace_back(len, it.x2, it.y2);
+		}
+		if (len > 0.0)
+			for (auto& pt : m_points)
+				pt.m_time /= len;
+	}
+	bool isEmpty() const { return m_points.empty(); }
+	double getDuration() const { return m_duration; }
+	bool isTempoLocked() const { return m_beats > 0.0; }
+	// playback position of the path at the given millisecond counter time, 0..1 with the time warp applied
+	double getNormalizedPosition(double nowms) const
+	{
+		double playpos = fmod(nowms - m_start_time, m_duration);
+		if (playpos < 0.0)
+			playpos += m_duration;
+		return warpPosition(playpos / m_duration, m_timewarp);
+	}
+	// cycles start at multiples of the cycle length from the project start, so the path stays on the grid
+	double getNormalizedPositionAtQN(double qn) const
+	{
+		double playpos = fmod(qn, m_beats);
+		if (playpos < 0.0)
+			playpos += m_beats;
+		return warpPosition(playpos / m_beats, m_timewarp);
+	}
+	static double warpPosition(double pathposnorm, double timewarp)
+	{
+		if (timewarp >= 0.0)
+			return pow(pathposnorm, 1.0 + 4.0*timewarp);
+		return 1.0 - pow(1.0 - pathposnorm, 1.0 + 4.0*-timewarp);
+	}
+	Point<double> getPointAt(double normpos) const
+	{
+		if (m_points.empty())
+			return {};
+		auto it = std::lower_bound(m_points.begin(), m_points.end(), normpos,
+			[](const PointWithTime& pt, double t) { return pt.m_time < t; });
+		if (it == m_points.begin())
+			return { it->m_x, it->m_y };
+		if (it == m_points.end())
+			return { m_points.back().m_x, m_points.back().m_y };
+		auto prev = it - 1;
+		double seglen = it->m_time - prev->m_time;
+		if (seglen <= 0.0)
+			return { it->m_x, it->m_y };
+		double frac = (normpos - prev->m_time) / seglen;
+		return { prev->m_x + (it->m_x - prev->m_x)*frac, prev->m_y + (it->m_y - prev->m_y)*frac };
+	}
+private:
+	std::vector<PointWithTime> m_points;
+	double m_duration = 5000.0;
+	double m_start_time = 0.0;
+	double m_timewarp = 0.0;
+	double m_beats = 0.0;
+};
@@ -0,0 +1,93 @@
+#include "xy_transport.h"
+#include "reaper_plugin_functions.h"
+
+XYTempoCache g_xy_tempo_cache;
+
+void XYTempoCache::update()
+{
+	XYTransportSnapshot transport;
+	transport.m_playing = (GetPlayState() & 1) != 0;
+	transport.m_play_pos = transport.m_playing == true ? GetPlayPosition2() : GetCursorPosition();
+	transport.m_time_ms = Time::getMillisecondCounterHiRes();
+	transport.m_play_rate = Master_GetPlayRate(nullptr);
+	const double pos = transport.m_play_pos;
+	XYTempoSegment seg = getSegment();
+	// one time map call per tick is enough to notice edits of the tempo map
+	const bool segmentok = seg.contains(pos) == true && pos < seg.m_time_end - 0.5 &&
+		std::abs(seg.timeToQN(pos) - TimeMap2_timeToQN(nullptr, pos)) < 1e-6;
+	if (segmentok == false)
+		seg = buildSegment(pos);
+	const SpinLock::ScopedLockType locker(m_lock);
+	m_segment = seg;
+	m_transport = transport;
+}
+
+XYTempoSegment XYTempoCache::getSegment() const
+{
+	const SpinLock::ScopedLockType locker(m_lock);
+	return m_segment;
+}
+
+XYTransportSnapshot XYTempoCache::getTransport() const
+{
+	const SpinLock::ScopedLockType locker(m_lock);
+	return m_transport;
+}
+
+XYTempoSegment XYTempoCache::buildSegment(double t)
+{
+	// a little behind the position too, so jitter in the extrapolated position stays inside
+	double t0 = jmax(0.0, t - 0.1);
+	double t1 = t + 4.0;
+	int idx = FindTempoTimeSigMarker(nullptr, t);
+	double markertime = 0.0;
+	int measure = 0;
+	double beat = 0.0;
+	double bpm = 0.0;
+	int signum = 0;
+	int sigdenom = 0;
+	bool linear = false;
+	if (idx >= 0 && GetTempoTimeSigMarker(nullptr, idx, &markertime, &measure, &beat, &bpm, &signum, &sigdenom, &linear) == true)
+		t0 = jmax(t0, markertime);
+	if (GetTempoTimeSigMarker(nullptr, idx + 1, &markertime, &measure, &beat, &bpm, &signum, &sigdenom, &linear) == true
+		&& markertime > t)
+		t1 = jmin(t1, markertime);
+	const double len = t1 - t0;
+	const double q0 = TimeMap2_timeToQN(nullptr, t0);
+	const double d1 = TimeMap2_timeToQN(nullptr, t0 + len * 0.5) - q0;
+	const double d2 = TimeMap2_timeToQN(nullptr, t1) - q0;
+	XYTempoSegment seg;
+	seg.m_time_start = t0;
+	seg.m_time_end = t1;
+	seg.m_qn_start = q0;
+	seg.m_b = 2.0 * (d2 - 2.0 * d1) / (len * len);
+	seg.m_a = (d2 - seg.m_b * len * len) / len;
+	return seg;
+}
+
+bool XYTransportFollower::getPathPosition(const XYPathSnapshot& path, double nowms, double& normpos)
+{
+	if (path.isTempoLocked() == false)
+	{
+		normpos = path.getNormalizedPosition(nowms);
+		return true;
+	}
+	const XYTransportSnapshot transport = g_xy_tempo_cache.getTransport();
+	if (transport.m_playing == false)
+		return false;
+	const double raw = transport.m_play_pos;
+	// not much further than a few message thread ticks, in case the updates stall
+	const double elapsed = jlimit(0.0, 0.25, (nowms - transport.m_time_ms) / 1000.0);
+	const double pos = raw + elapsed * transport.m_play_rate;
+	XYTempoSegment seg = g_xy_tempo_cache.getSegment();
+	if (seg.contains(pos) == false)
+	{
+		// the message thread has not caught up with a seek or loop yet
+		if (seg.contains(raw) == false)
+			return false;
+		normpos = path.getNormalizedPositionAtQN(seg.timeToQN(raw));
+		return true;
+	}
+	normpos = path.getNormalizedPositionAtQN(seg.timeToQN(pos));
+	return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "xy_path.h"
+
+// Piece of the project tempo map around the play position, as a quadratic in time. That is exact
+// for constant tempos and linear tempo ramps, and the segment never spans a tempo marker.
+struct XYTempoSegment
+{
+	double m_time_start = 0.0;
+	double m_time_end = -1.0;
+	double m_qn_start = 0.0;
+	double m_a = 0.0;
+	double m_b = 0.0;
+	bool contains(double t) const { return t >= m_time_start && t < m_time_end; }
+	double timeToQN(double t) const
+	{
+		const double dt = t - m_time_start;
+		return m_qn_start + m_a * dt + m_b * dt * dt;
+	}
+};
+
+// Transport state as seen by the message thread at m_time_ms
+struct XYTransportSnapshot
+{
+	bool m_playing = false;
+	double m_play_pos = 0.0;
+	double m_time_ms = 0.0;
+	double m_play_rate = 1.0;
+};
+
+// Tempo segment and transport state shared by the XY pads. Refreshed from the message thread,
+// read from any thread without calling into REAPER.
+class XYTempoCache
+{
+public:
+	// message thread only, cheap when the cached segment still covers the play position
+	void update();
+	XYTempoSegment getSegment() const;
+	XYTransportSnapshot getTransport() const;
+private:
+	XYTempoSegment buildSegment(double t);
+	mutable SpinLock m_lock;
+	XYTempoSegment m_segment;
+	XYTransportSnapshot m_transport;
+};
+
+extern XYTempoCache g_xy_tempo_cache;
+
+// Follows the project play position from the transport snapshot of g_xy_tempo_cache, extrapolated
+// from the wall clock between the message thread updates. Calls no REAPER API, so it can run on
+// any thread.
+class XYTransportFollower
+{
+public:
+	// false if the path is tempo locked and the project is not playing, the position should then hold
+	bool getPathPosition(const XYPathSnapshot& path, double nowms, double& normpos);
+};